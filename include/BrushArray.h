@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "cinder/Filesystem.h"
+#include "cinder/gl/gl.h"
+#include "cinder/Surface.h"
+#include "cinder/Vector.h"
+
+/** Brush images packed into the layers of a single 2d array texture, so
+ *  strokes with different brushes can be drawn with one texture binding.
+ *  All brushes are resized to the size of the first one.
+ */
+class BrushArray
+{
+	public:
+		BrushArray();
+		~BrushArray();
+
+		/** Loads the png files of the asset directory \a relativeDir, the layers follow the file order.
+		 *  Without \a upload the images are only kept as surfaces for cpu rendering, no gl context is needed.
+		 */
+		void load( const ci::fs::path &relativeDir, bool upload = true );
+
+		//! Returns the file names of the brushes, the index is the layer.
+		const std::vector< std::string > &getNames() const { return mNames; }
+		size_t getCount() const { return mNames.size(); }
+		ci::Vec2i getSize() const { return mSize; }
+		//! Returns the rgba image of \a layer, kept for cpu rendering.
+		const ci::Surface8u &getSurface( size_t layer ) const { return mSurfaces[ layer ]; }
+
+		void bind( GLuint textureUnit = 0 ) const;
+		void unbind( GLuint textureUnit = 0 ) const;
+
+		operator bool() const { return mId != 0; }
+
+	private:
+		BrushArray( const BrushArray & );
+		BrushArray &operator=( const BrushArray & );
+
+		GLuint                     mId;
+		ci::Vec2i                  mSize;
+		std::vector< std::string > mNames;
+		std::vector< ci::Surface8u > mSurfaces;
+};
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "cinder/app/App.h"
+#include "cinder/Matrix.h"
 #include "cinder/Vector.h"
 #include "cinder/Rect.h"
 
@@ -12,6 +13,8 @@ public:
 	Calibrate();
 
 	void setup();
+	//! Picks up parameter changes, has to be called once a frame.
+	void update();
 
 	void mouseDown( ci::app::MouseEvent event );
 	void mouseDrag( ci::app::MouseEvent event );
@@ -19,6 +22,12 @@ public:
 
 	const ci::Vec2f transform( const ci::Vec2f pos ) const;
 	const ci::Vec2f transform( const ci::Vec2f pos, const ci::Vec2f posRef ) const;
+	//! Returns the affine matrix of transform( pos ).
+	const ci::Matrix44f &getMatrix() const { return mMatrix; }
+	//! Returns the affine matrix of transform( pos, posRef ).
+	ci::Matrix44f getMatrix( const ci::Vec2f &posRef ) const;
+	//! Returns a counter which changes every time the transformation changes.
+	uint32_t getVersion() const { return mVersion; }
 	const ci::Rectf getCoverLeft() const;
 	const ci::Rectf getCoverRight() const;
 	const ci::Rectf getCoverTop() const;
@@ -53,6 +62,12 @@ private:
 
 	ci::Vec2i                mMousePos;
 
+	// transformation cached from params
+	ci::Vec2f                mTranslate;
+	ci::Vec2f                mScale;
+	ci::Matrix44f            mMatrix;
+	uint32_t                 mVersion;
+
 	static const float       MIN_TRANSLATE;
 	static const float       MAX_TRANSLATE;
 	static const float       STEP_TRANSLATE;
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "cinder/gl/Fbo.h"
+#include "cinder/gl/GlslProg.h"
+#include "cinder/gl/Texture.h"
+
+#include "Kaleidoscope.h"
+#include "NIUser.h"
+
+/** Stroke canvas of the users. The new stroke segments are drawn every frame,
+ *  blended with the previous canvas, which is faded out, and processed by the
+ *  kaleidoscope. Used by the interactive and the offline renderer alike.
+ */
+class Canvas
+{
+	public:
+		enum BlendModes
+		{
+			BLENDMODE_DARKEN = 0,
+			BLENDMODE_ERASE
+		};
+
+		void setup( int width, int height );
+		void clear();
+
+		//! Draws the new strokes of \a userManager and blends them with the canvas faded by \a fadeout.
+		void draw( ci::UserManager &userManager, float fadeout, int blendmode );
+
+		//! Returns the last canvas, processed by the kaleidoscope if it is enabled and \a processed is set.
+		ci::gl::Texture getTexture( bool processed = true );
+
+		const ci::gl::Fbo &getFbo() const { return mFbo; }
+		ci::Vec2i getSize() const { return mFbo.getSize(); }
+
+	private:
+		ci::gl::Fbo      mFbo;
+		ci::gl::GlslProg mBlendShader;
+		int              mFboPingPongId; // 1 or 2, the attachment blended to next
+
+		KaleidoscopeRef  mKaleidoscope;
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+/** Fixed timestep clock. The elapsed render time is accumulated and consumed
+ *  in steps of constant length, so the simulation does not depend on the
+ *  frame rate. The remainder is available as an interpolation factor for
+ *  rendering between the last two simulation states.
+ */
+class FixedTimestep
+{
+	public:
+		FixedTimestep( double rate = 60.0, int maxSteps = 8 );
+
+		void   setRate( double rate );
+		double getRate() const { return mRate; }
+		//! Returns the length of a step in seconds.
+		double getStep() const { return 1.0 / mRate; }
+
+		//! Sets the maximum number of steps per frame, time above it is dropped.
+		void setMaxSteps( int maxSteps ) { mMaxSteps = maxSteps; }
+		int  getMaxSteps() const { return mMaxSteps; }
+
+		//! Advances the clock by \a elapsed seconds, returns the number of steps to simulate.
+		int   advance( double elapsed );
+		//! Returns the fraction of a step accumulated but not simulated yet, in [0, 1).
+		float getAlpha() const { return float( mAccumulator * mRate ); }
+
+		void reset() { mAccumulator = 0.0; }
+
+	private:
+		double mRate;
+		int    mMaxSteps;
+		double mAccumulator;
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+
+#include "cinder/Vector.h"
+
+#include "JointStream.h"
+#include "JointTable.h"
+
+/** One Euro filter of the joints of all users, an adaptive low-pass filter
+ *  whose cutoff frequency rises with the speed of the joint: slow joints are
+ *  smoothed strongly, fast ones follow with little lag. Every user owns a
+ *  block of lanes indexed by the JointTable slot, the state is kept in
+ *  structure-of-arrays form and all lanes are filtered together with SSE if
+ *  available. The filtered velocity also extrapolates the joints between
+ *  the sensor frames. See Casiez et al., 1€ Filter, CHI 2012.
+ */
+class JointFilter
+{
+	public:
+		JointFilter();
+
+		//! Sets the filter of the joint \a slot, \a minCutoff in Hz is the cutoff at rest, \a beta raises it with the speed.
+		void setParams( int slot, float minCutoff, float beta );
+
+		/** Filters the joints of \a frame with at least sMinConfidence and returns their positions
+		 *  in the order of frame.joints, the others are returned unfiltered. Users missing from
+		 *  the frame are forgotten, their joints restart from the first sample.
+		 */
+		const std::vector< ci::Vec2f > &apply( const JointFrame &frame );
+
+		/** Returns the joints of the last frame given to apply extrapolated to \a time with their
+		 *  filtered velocity, in the order of frame.joints. The extrapolation is limited to
+		 *  \a maxHorizon seconds after the frame, the unfiltered joints are not moved.
+		 */
+		const std::vector< ci::Vec2f > &predict( double time, double maxHorizon );
+
+		//! Forgets all users.
+		void reset();
+
+		static const float sMinConfidence;
+
+	private:
+		size_t getBlock( unsigned userId );
+		void   resize( size_t blockCount );
+		void   filterScalar( size_t beg, size_t end, float dt );
+
+		template< typename Ops >
+		void filterKernel( size_t beg, size_t end, float dt );
+
+		static const size_t sBlockSize = 16; // lanes of a user, JointTable::sCount rounded up to the widest kernel
+
+		std::vector< unsigned > mBlockUsers;
+		std::vector< bool >     mBlockUsed;
+		std::vector< bool >     mBlockSeen; // the user is in the current frame
+		size_t                  mCount; // number of lanes
+		std::vector< int >      mLanes; // lane of each joint of the current frame, -1 if not filtered
+
+		// state
+		std::vector< float > mX, mY;   // filtered position
+		std::vector< float > mDx, mDy; // filtered velocity
+		std::vector< float > mRawX, mRawY; // last sample
+		std::vector< float > mStarted; // has a position already, 0 or 1
+
+		// input of the current frame
+		std::vector< float > mInX, mInY;
+		std::vector< float > mInput; // has a sample, 0 or 1
+
+		// params
+		float                mMinCutoff[ JointTable::sCount ];
+		float                mBeta[ JointTable::sCount ];
+		std::vector< float > mLaneMinCutoff;
+		std::vector< float > mLaneBeta;
+
+		bool                 mHasTime;
+		double               mTime;
+
+		std::vector< ci::Vec2f > mOutput;
+		std::vector< ci::Vec2f > mPrediction;
+
+		static const float   sDerivateCutoff;
+		static const double  sMaxGap;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stdint.h>
+#include <exception>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "cinder/Filesystem.h"
+#include "cinder/Thread.h"
+#include "cinder/Vector.h"
+
+//! Tracked joints of all users at one time.
+struct JointFrame
+{
+	struct Joint
+	{
+		Joint() {}
+		Joint( unsigned _userId, int _jointId, ci::Vec2f _pos, float _confidence ) :
+			userId( _userId ), jointId( _jointId ), pos( _pos ), confidence( _confidence ) {}
+
+		unsigned  userId;
+		int       jointId;
+		ci::Vec2f pos;        // in kinect image coordinates
+		float     confidence;
+	};
+
+	double               time; // seconds since the beginning of the stream
+	std::vector< Joint > joints; // joints of a user are consecutive
+};
+
+/** Writes joint frames to a binary stream. The file starts with the magic
+ *  "PRJS" and a version byte, each frame is a double time, a uint16 joint
+ *  count and the joints as uint16 user id, uint8 joint id and float x, y,
+ *  confidence.
+ */
+class JointStreamWriter
+{
+	public:
+		JointStreamWriter();
+		~JointStreamWriter();
+
+		//! Starts writing to \a path on a background thread, throws JointStreamExc if it cannot be written.
+		void open( const ci::fs::path &path );
+		//! Writes the queued frames and closes the file.
+		void close();
+		bool isOpen() const;
+
+		//! Queues \a frame for writing, the frame times are stored relative to the first frame.
+		void write( const JointFrame &frame );
+
+		//! Returns the number of frames dropped because the writer could not keep up.
+		size_t getDropped() const;
+
+	private:
+		JointStreamWriter( const JointStreamWriter & );
+		JointStreamWriter &operator=( const JointStreamWriter & );
+
+		void writeThread();
+
+		mutable std::mutex      mMutex;
+		std::condition_variable mCond;
+		std::thread             mThread;
+		bool                    mOpen;
+		bool                    mStarted;
+		double                  mStartTime;
+		size_t                  mDropped;
+		std::vector< uint8_t >  mPending; // encoded frames, bounded by sQueueCapacity bytes
+
+		static const size_t     sQueueCapacity;
+
+		// only used by the writer thread
+		std::ofstream           mFile;
+		std::vector< uint8_t >  mBuffer;
+};
+
+class JointStreamReader
+{
+	public:
+		//! Opens \a path, throws JointStreamExc if it is not a joint stream.
+		JointStreamReader( const ci::fs::path &path );
+
+		//! Reads the next frame, returns false at the end of the stream.
+		bool read( JointFrame *frame );
+
+	private:
+		std::ifstream          mFile;
+		std::vector< uint8_t > mBuffer;
+};
+
+class JointStreamExc : public std::exception
+{
+	public:
+		JointStreamExc( const std::string &message ) throw() : mMessage( message ) {}
+		virtual ~JointStreamExc() throw() {}
+		virtual const char *what() const throw() { return mMessage.c_str(); }
+
+	private:
+		std::string mMessage;
+};
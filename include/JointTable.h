@@ -0,0 +1,46 @@
+#pragma once
+
+#include "NIBackend.h"
+
+/** Skeleton joints used by the app. The index in the table is the joint slot,
+ *  the per-joint state of users and params are arrays indexed by the slot.
+ *  The joints with strokes come first, the others are only tracked for the
+ *  body lines. The tables are constant data, nothing is set up at runtime.
+ */
+class JointTable
+{
+	public:
+		struct Joint
+		{
+			XnSkeletonJoint id;
+			const char     *name;
+			bool            visible;      // drawn as a circle and has a stroke
+			int             defaultBrush; // brush layer, used if the brush array has so many layers
+			float           minCutoff;    // default JointFilter params
+			float           beta;
+		};
+
+		//! Body line between two joint slots.
+		struct Bone
+		{
+			int slot0;
+			int slot1;
+		};
+
+		static const int   sCount       = 13;
+		static const int   sStrokeCount = 10; // the visible joints with strokes, slots [0, sStrokeCount)
+		static const int   sBoneCount   = 14;
+
+		static const Joint sJoints[ sCount ];
+		static const Bone  sBones[ sBoneCount ];
+
+		//! Returns the slot of \a id, -1 if it is not in the table.
+		static int getSlot( XnSkeletonJoint id )
+		{
+			return ( ( id >= 0 ) && ( id < sIdCount ) ) ? sSlots[ id ] : -1;
+		}
+
+	private:
+		static const int   sIdCount = XN_SKEL_RIGHT_FOOT + 1;
+		static const int   sSlots[ sIdCount ];
+};
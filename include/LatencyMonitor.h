@@ -0,0 +1,75 @@
+#pragma once
+
+#include <fstream>
+
+#include "cinder/Filesystem.h"
+
+#include "PParams.h"
+
+/** Histograms of the motion-to-photon latency, the time from the acquisition
+ *  of a skeleton frame until its joints reach each stage of the pipeline.
+ *  Every skeleton frame is counted once per stage, when the first joints of
+ *  it arrive there. The statistics of the last interval are shown in a
+ *  params bar and optionally appended to a log file.
+ */
+class LatencyMonitor
+{
+	public:
+		enum Stage
+		{
+			STAGE_APPLY = 0, // the joints are applied to the users
+			STAGE_EMIT,      // stroke points towards the joints are emitted and built
+			STAGE_DRAW,      // the stroke points are blended into the canvas
+			STAGE_SWAP,      // the frame with the stroke points is swapped to the screen
+			STAGE_COUNT
+		};
+
+		LatencyMonitor();
+
+		//! Creates the params bar, the log is written to \a logPath while it is enabled there.
+		void setup( const ci::fs::path &logPath );
+
+		//! Adds the latency of joints acquired at \a jointTime reaching \a stage at \a time, times on the app clock.
+		void add( Stage stage, double jointTime, double time );
+
+		//! Shows the statistics and writes them to the log at the end of each interval.
+		void update( double time );
+
+	private:
+		struct Histogram
+		{
+			Histogram();
+			void   clear();
+			void   add( double latency );
+			//! Returns the upper bound of the bucket containing the \a fraction quantile in seconds.
+			double getQuantile( double fraction ) const;
+
+			static const int sBucketCount = 51; // 5 ms buckets, the last one counts the longer latencies
+
+			int    buckets[ sBucketCount ];
+			int    count;
+			double sum;
+			double max;
+		};
+
+		void writeLog( double time );
+
+		Histogram       mHistograms[ STAGE_COUNT ];
+		double          mLastJointTime[ STAGE_COUNT ];
+		double          mIntervalStart;
+
+		ci::fs::path    mLogPath;
+		std::ofstream   mLog;
+
+		// params, in milliseconds
+		mndl::params::PInterfaceGl mParams;
+		bool            mLogEnabled;
+		float           mMean[ STAGE_COUNT ];
+		float           mMedian[ STAGE_COUNT ];
+		float           mPercentile95[ STAGE_COUNT ];
+		float           mMax[ STAGE_COUNT ];
+
+		static const double sBucketSize;
+		static const double sInterval;
+		static const char  *sStageNames[ STAGE_COUNT ];
+};
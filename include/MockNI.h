@@ -0,0 +1,128 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "cinder/Filesystem.h"
+#include "cinder/Surface.h"
+#include "cinder/Vector.h"
+
+#include "SyntheticSource.h"
+
+/* Stand-in for the part of the Cinder-NI block used by the app, selected by
+ * USE_MOCK_NI in NIBackend.h. The device generates synthetic users, the
+ * recordings are joint streams instead of .oni files. The user tracker calls
+ * the listeners like OpenNI, so the tracking code runs as with a sensor. */
+
+typedef enum XnSkeletonJoint
+{
+	XN_SKEL_HEAD           = 1,
+	XN_SKEL_NECK           = 2,
+	XN_SKEL_TORSO          = 3,
+	XN_SKEL_WAIST          = 4,
+
+	XN_SKEL_LEFT_COLLAR    = 5,
+	XN_SKEL_LEFT_SHOULDER  = 6,
+	XN_SKEL_LEFT_ELBOW     = 7,
+	XN_SKEL_LEFT_WRIST     = 8,
+	XN_SKEL_LEFT_HAND      = 9,
+	XN_SKEL_LEFT_FINGERTIP = 10,
+
+	XN_SKEL_RIGHT_COLLAR   = 11,
+	XN_SKEL_RIGHT_SHOULDER = 12,
+	XN_SKEL_RIGHT_ELBOW    = 13,
+	XN_SKEL_RIGHT_WRIST    = 14,
+	XN_SKEL_RIGHT_HAND     = 15,
+	XN_SKEL_RIGHT_FINGERTIP= 16,
+
+	XN_SKEL_LEFT_HIP       = 17,
+	XN_SKEL_LEFT_KNEE      = 18,
+	XN_SKEL_LEFT_ANKLE     = 19,
+	XN_SKEL_LEFT_FOOT      = 20,
+
+	XN_SKEL_RIGHT_HIP      = 21,
+	XN_SKEL_RIGHT_KNEE     = 22,
+	XN_SKEL_RIGHT_ANKLE    = 23,
+	XN_SKEL_RIGHT_FOOT     = 24
+} XnSkeletonJoint;
+
+typedef unsigned int XnUserID;
+
+namespace mndl { namespace ni {
+
+class MockDevice;
+
+class UserTracker
+{
+	public:
+		struct UserEvent
+		{
+			XnUserID id;
+		};
+
+		class Listener
+		{
+			public:
+				virtual ~Listener() {}
+
+				virtual void newUser( UserEvent event ) {}
+				virtual void lostUser( UserEvent event ) {}
+				virtual void calibrationBeg( UserEvent event ) {}
+				virtual void calibrationEnd( UserEvent event ) {}
+		};
+
+		UserTracker() {}
+
+		void addListener( Listener *listener );
+		//! The joints are not smoothed, the setting is ignored.
+		void setSmoothing( float smoothing ) {}
+		//! Returns the joint in depth image coordinates, \a conf is 0 if the user or joint is not tracked.
+		ci::Vec2f getJoint2d( XnUserID userId, XnSkeletonJoint jointId, float *conf = NULL );
+
+	private:
+		UserTracker( std::shared_ptr< MockDevice > device ) : mDevice( device ) {}
+
+		std::shared_ptr< MockDevice > mDevice;
+
+		friend class OpenNI;
+};
+
+class OpenNI
+{
+	public:
+		struct Device
+		{
+			Device( int index = 0 ) : index( index ) {}
+			int index;
+		};
+
+		OpenNI() {}
+		//! Generates the users of the synthetic options, see setDeviceOptions, the seed is offset by the device index.
+		OpenNI( Device device );
+		//! Plays the joint stream at \a recording, throws JointStreamExc if it cannot be read.
+		OpenNI( const ci::fs::path &recording );
+
+		//! Sets the users generated by the devices opened later.
+		static void setDeviceOptions( const SyntheticSource::Options &options );
+
+		void setDepthAligned( bool aligned = true ) {}
+		void start();
+
+		bool isMirrored() const;
+		void setMirrored( bool mirrored = true );
+
+		//! There is no video, no video frame is ever new.
+		bool checkNewVideoFrame() { return false; }
+		ci::Surface8u getVideoImage() { return ci::Surface8u(); }
+		//! Reads the next skeleton frame of the source, calls the listeners for its user events.
+		bool checkNewDepthFrame();
+
+		UserTracker getUserTracker() { return UserTracker( mDevice ); }
+
+	private:
+		std::shared_ptr< MockDevice > mDevice;
+
+		static SyntheticSource::Options sDeviceOptions;
+};
+
+} } // namespace mndl::ni
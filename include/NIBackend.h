@@ -0,0 +1,10 @@
+#pragma once
+
+/** The OpenNI types of the Cinder-NI block, or the stand-in of MockNI.h if
+ *  USE_MOCK_NI is defined to 1, for builds without the block and the SDK.
+ */
+#if USE_MOCK_NI
+#include "MockNI.h"
+#else
+#include "CiNI.h"
+#endif
@@ -1,6 +1,10 @@
 #pragma once
 
+#include <functional>
 #include <map>
+
+#include <boost/atomic.hpp>
+
 #include "cinder/app/App.h"
 #include "cinder/gl/Fbo.h"
 #include "cinder/gl/Texture.h"
@@ -9,68 +13,120 @@
 #include "cinder/Rect.h"
 #include "cinder/Thread.h"
 
-#include "CiNI.h"
+#include "BrushArray.h"
+#include "JointFilter.h"
+#include "JointStream.h"
+#include "JointTable.h"
+#include "NIBackend.h"
 #include "PParams.h"
+#include "SensorFusion.h"
+#include "SkeletonSource.h"
+#include "SpscRing.h"
+#include "StreamTexture.h"
+#include "StrokeBatch.h"
 #include "StrokeManager.h"
+#include "StrokeRecorder.h"
+#include "SyntheticSource.h"
 #include "Calibrate.h"
 
-#define USE_KINECT_RECORD 0
-
 namespace cinder {
 
 class UserManager;
 
 class User
 {
-typedef std::map< XnSkeletonJoint, ci::Vec2f > JointPositions;
-
 public:
 	User( UserManager *userManager );
 
 	void update();
-	void addPos( XnSkeletonJoint jointId, ci::Vec2f pos );
+	void buildStrokes( float alpha, StrokeBatch &batch );
+	void updateTransform( const Calibrate &calibrate );
+	//! \a time is when the joint was acquired.
+	void addPos( XnSkeletonJoint jointId, ci::Vec2f pos, float confidence, double time );
 
 	void clearPoints();
 	void addStroke( XnSkeletonJoint jointId );
+	//! Allocates the stroke storage of \a jointId in advance.
+	void reserveStroke( XnSkeletonJoint jointId );
+	//! Forgets the joints and destroys the strokes for reuse as a new user, the stroke storage is kept.
+	void reset();
+	void setRecorder( StrokeRecorder *recorder, unsigned userId );
 	void clearStrokes();
-	void drawStroke( const Calibrate &calibrate );
 	void drawBody  ( const Calibrate &calibrate );
 
 private:
-	void drawJoints( const Calibrate &calibrate );
-	void drawLines ( const Calibrate &calibrate );
-	void drawLine  ( const Calibrate &calibrate, XnSkeletonJoint jointBeg, XnSkeletonJoint jointEnd );
+	void drawJoints( const ci::Matrix44f &transform );
+	void drawLines ( const ci::Matrix44f &transform );
 
 private:
 	UserManager     *mUserManager;
-	JointPositions   mJointPositions;
+	// indexed by the JointTable slot, a joint is set in this frame if its confidence is above 0
+	ci::Vec2f        mJointPositions  [ JointTable::sCount ];
+	float            mJointConfidences[ JointTable::sCount ];
 	StrokeManager    mStrokeManager;
 	ci::Vec2f        mPosRef;
+	ci::Matrix44f    mStrokeTransform;
+	// the stroke transform is rebuilt when the calibration or the reference position changes
+	bool             mStrokeTransformValid;
+	uint32_t         mStrokeTransformVersion;
+	ci::Vec2f        mStrokeTransformPos;
+
+	ci::Vec2f        mLineVertices[ JointTable::sBoneCount * 2 ];
 };
 
-class UserManager : mndl::ni::UserTracker::Listener
+class UserManager
 {
 typedef std::shared_ptr< User >                                  UserRef;
 typedef std::map< unsigned, UserRef >                            Users;
-typedef std::vector< std::pair< std::string, ci::gl::Texture > > Brushes;
-typedef std::vector< XnSkeletonJoint >                           Joints;
 public:
 	UserManager();
 	~UserManager();
 
-	void setup( const ci::fs::path &path = "" );
+	//! Sets up reading the skeletons from the source selected in the params, it is opened by update.
+	void setup();
+	//! Sets up without a source, the joints are given to replayJoints. Without \a gl the brushes are not uploaded for drawStroke.
+	void setupReplay( bool gl = true );
+	//! Selects the source like the params, an empty \a path keeps the files of the params, several files are separated by ';'.
+	void setSource( SkeletonSource::Type type, const ci::fs::path &path = "" );
+	//! Sets the number of sensors like the params, each reads a source of the selected type.
+	void setSensorCount( int count ) { mSensorCount = ci::math< int >::clamp( count, 1, sMaxSensors ); mSourceReopen = true; }
+	//! Sets the users of the synthetic source like the params, the values are clamped to the param ranges.
+	void setSyntheticOptions( const SyntheticSource::Options &options );
+	const SyntheticSource::Options &getSyntheticOptions() const { return mSyntheticOptions; }
+	/** Opens the sources at the start, on the Open source button or after the setters above,
+	 *  applies the user events published by the sensor threads since the last call and the
+	 *  fused joints of their last frames.
+	 */
 	void update();
-	void drawStroke( const Calibrate &calibrate );
+	//! Applies the joints of a recorded frame, creates and destroys the users to match it.
+	void replayJoints( const JointFrame &frame );
+	//! Moves the filtered joints of the last frame to where they are expected at \a time plus the prediction param, on the clock of the frame times.
+	void predictJoints( double time );
+	/** Steps the stroke simulation \a steps times and builds the stroke geometry on the stroke
+	 *  thread, \a alpha is the interpolation factor between the last two steps. The geometry
+	 *  built in the previous frame is drawn meanwhile.
+	 */
+	void updateStrokes( int steps, double stepTime, float alpha, const Calibrate &calibrate );
+	//! Waits for the stroke thread, the users must not be changed while it is running.
+	void waitStrokes();
+	//! Draws the new segments of all users with one call.
+	void drawStroke();
+	//! Returns the segments drawn by drawStroke.
+	const StrokeBatch &getStrokeBatch() const { return mStrokeBatches[ mStrokeFront ]; }
+	const BrushArray  &getBrushes() const { return mBrushes; }
 	void drawBody  ( const Calibrate &calibrate );
 
 	void setBounds( const Rectf &rect );
 	void setSourceBounds( const ci::Area &area );
 	void clearStrokes();
 
-	void newUser       ( mndl::ni::UserTracker::UserEvent event );
-	void lostUser      ( mndl::ni::UserTracker::UserEvent event );
-	void calibrationBeg( mndl::ni::UserTracker::UserEvent event );
-	void calibrationEnd( mndl::ni::UserTracker::UserEvent event );
+	//! Records the emitted stroke points of all users, see StrokeRecorder.
+	StrokeRecorder &getRecorder() { return mRecorder; }
+	//! Returns the acquisition time of the last skeleton frame applied, negative if there was none.
+	double getJointTime() const { return mJointTime; }
+
+	//! Records the tracked joints for replay.
+	JointStreamWriter &getJointRecorder() { return mJointRecorder; }
 
 	bool mouseDown( ci::app::MouseEvent event );
 	bool mouseDrag( ci::app::MouseEvent event );
@@ -84,47 +140,67 @@ public:
 	}
 
 private:
+	void    setupCommon( bool gl );
+	void    applyJoints( const JointFrame &frame );
+	//! Adds the confident joints of \a frame to the users, at \a positions if given.
+	void    addJoints( const JointFrame &frame, const std::vector< ci::Vec2f > *positions );
+
 	void    createUser ( unsigned userId );
 	void    destroyUser( unsigned userId );
 	UserRef findUser   ( unsigned userId );
 
-	bool            getStrokeActive( XnSkeletonJoint jointId );
-	ci::gl::Texture getStrokeBrush ( XnSkeletonJoint jointId );
+	//! Grows the pool to hold \a count users with the users in use.
+	void    reserveUsers( size_t count );
+	//! Returns a user from the pool, allocates one only if the pool is empty.
+	UserRef acquireUser();
+	//! Resets \a user and puts it back to the pool, the users the pool cannot hold are freed on the reclaim thread.
+	void    releaseUser( UserRef user );
+	//! Frees the released users and joins the stopped sensor threads.
+	void    reclaimThread();
 
-private:
-	enum JointType
-	{
-		LEFT_HAND      = 0,
-		LEFT_SHOULDER  = 1,
-		HEAD           = 2,
-		RIGHT_HAND     = 3,
-		RIGHT_SHOULDER = 4,
-		TORSO          = 5,
-		LEFT_KNEE      = 6,
-		RIGHT_KNEE     = 7,
-		LEFT_FOOT      = 8,
-		RIGHT_FOOT     = 9,
-	};
+	//! \a slot is a JointTable slot with a stroke.
+	bool            getStrokeActive( int slot ) const { return mStrokeActive[ slot ]; }
+	//! Returns the brush layer of \a slot, -1 for no stroke.
+	int             getStrokeBrush ( int slot ) const { return mStrokeSelect[ slot ] - 1; }
 
-	mndl::ni::OpenNI      mNI;
-	mndl::ni::UserTracker mNIUserTracker;
-
-	Joints  mJoints;
-	Brushes mBrushes;
+private:
+	BrushArray mBrushes;
+	JointFilter mJointFilter;
 	XnSkeletonJoint mJointRef;
 
 	ci::Rectf       mOutputRect;
-	ci::RectMapping mOutputMapping;
+	ci::RectMapping mOutputMapping; // from the stage to the output rect
+	ci::Rectf       mStageRect;     // bounds of the sensor images in the stage
 	ci::Area        mSourceBounds;
 
-	ci::gl::Texture     mNITexture;
+	StreamTexture       mNIVideo; // written by the first sensor thread while the video is shown, if the source has video
 
 	ci::gl::Fbo         mFbo;
 
 	// params
 	mndl::params::PInterfaceGl mParams;
 	std::string              mKinectProgress;
-	float                    mSkeletonSmoothing;
+	bool                     mStatusChanged; // rebuilds mKinectProgress from the sensor states
+	int                      mSourceType;
+	std::string              mRecordingPath;
+	std::string              mJointStreamPath;
+	SyntheticSource::Options mSyntheticOptions;
+	static const int         sMaxSensors = 4;
+	static const int         sMaxSyntheticUsers = 50;
+	static const int         sMaxSyntheticChurn = 10; // users per second
+	int                      mSensorCount;
+	float                    mSensorX       [ sMaxSensors ]; // extrinsics, the offset of the sensor image in the stage
+	float                    mSensorY       [ sMaxSensors ];
+	float                    mSensorScale   [ sMaxSensors ];
+	float                    mSensorRotation[ sMaxSensors ]; // degrees
+	float                    mFusionDistance;
+	bool                     mJointFilterEnabled;
+	float                    mFilterMinCutoff[ JointTable::sCount ];
+	float                    mFilterBeta     [ JointTable::sCount ];
+	float                    mPrediction;
+	JointFrame               mPredictFrame; // last frame of the filter
+	double                   mJointTime;
+	static const double      sMaxFrameDelay;
 	bool                     mJointShow;
 	bool                     mLineShow;
 	bool                     mVideoShow;
@@ -132,15 +208,140 @@ private:
 	float                    mJointSize;
 	ci::ColorA               mJointColor;
 
-	int                      mStrokeSelect[10];
-	bool                     mStrokeActive[10];
+	int                      mStrokeSelect[ JointTable::sStrokeCount ];
+	bool                     mStrokeActive[ JointTable::sStrokeCount ];
+
+	// messages of the sensor threads to the render thread
+	struct TrackerMessage
+	{
+		enum Type
+		{
+			USER_NEW,
+			USER_LOST,
+			FRAME,
+			STATUS // the source status after opening it, in status
+		};
+
+		Type        type;
+		unsigned    userId;
+		JointFrame  frame;
+		std::string status;
+	};
+
+	/* A source read on its own thread, its joints are mapped to the stage there.
+	 * The thread opens the source, reads it while it delivers frames and opens
+	 * a new one if it fails to open or stops delivering, until quit. */
+	struct Sensor
+	{
+		enum State
+		{
+			STATE_CONNECTING = 0, // opening the source for the first time
+			STATE_RUNNING,
+			STATE_LOST,           // failed to open or stopped sending frames, waiting to retry
+			STATE_RECONNECTING,   // opening a new source after STATE_LOST
+			STATE_COUNT
+		};
+		static const char *sStateNames[ STATE_COUNT ];
+
+		// copies of the params for the sensor thread
+		struct Params
+		{
+			Params() : mirrored( false ), videoShow( false ) {}
 
-	std::thread              mThread;
-	std::mutex               mMutex;
-	void                     openKinect( const ci::fs::path &path );
+			bool operator==( const Params &o ) const
+			{
+				return ( extrinsics == o.extrinsics ) && ( mirrored == o.mirrored ) && ( videoShow == o.videoShow );
+			}
+			bool operator!=( const Params &o ) const { return ! ( *this == o ); }
+
+			SensorFusion::Extrinsics extrinsics;
+			bool                     mirrored;
+			bool                     videoShow;
+		};
+
+		Sensor() : quit( false ), paramsSent( false ), state( STATE_CONNECTING ), retries( 0 ), shownState( -1 ), shownRetries( 0 ) {}
+
+		std::thread                thread;
+		std::mutex                 mutex; // guards quit and params
+		bool                       quit;
+		Params                     params;
+		Params                     sentParams; // of the render thread, the params are only passed when they change
+		bool                       paramsSent;
+		boost::atomic< int >       state;   // written by the sensor thread only, read without locking
+		boost::atomic< int >       retries; // since the last time running
+		std::string                status;  // of the render thread, set by the STATUS messages
+		int                        shownState; // of the render thread, state and retries in the status
+		int                        shownRetries;
+		SpscRing< TrackerMessage > ring;
+	};
+	typedef std::shared_ptr< Sensor > SensorRef;
+	typedef std::function< SkeletonSourceRef () > SourceFactory;
+
+	bool                     mSourceEnabled;  // not for replay
+	bool                     mSourceReopen;   // the source params are applied in the next update
+	int                      mOpenSourceType; // -1 if no source is open
+	std::string              mOpenSourcePath;
+	//! Applies the source params, they are not applied while edited, a half typed file is not opened.
+	void                     reopenSource() { mSourceReopen = true; }
+	std::string              getSourcePath( int type ) const;
+	//! Closes the open sources and opens the ones selected in the params.
+	void                     openSource();
+	//! Stops the sensor threads and destroys the users of the sources.
+	void                     closeSource();
+	//! Passes the extrinsics of the params to the sensors, updates the stage and the status.
+	void                     updateSensors();
+
+	std::vector< SensorRef > mSensors;
+	static SkeletonSourceRef createSource( SkeletonSource::Type type, const ci::fs::path &path, int device,
+										   const SyntheticSource::Options &options );
+	void                     trackerThread( SensorRef sensor, SourceFactory factory, bool video );
+	//! Reads \a source until it stops sending frames or quit, returns false on quit.
+	bool                     readSource( Sensor &sensor, SkeletonSourceRef source, bool video, std::vector< unsigned > &users );
+	//! Waits for room in the ring of \a sensor, returns NULL on quit.
+	TrackerMessage          *beginMessage( Sensor &sensor );
+	//! Tells the sensor threads to quit and hands them to the reclaim thread to join, never waits for them.
+	void                     stopTracker();
+	bool                     getTrackerQuit( Sensor &sensor );
+	void                     setTrackerState( Sensor &sensor, Sensor::State state, int retries );
+	static const double      sRetryDelay;    // after the source was lost, doubled up to sMaxRetryDelay for each retry
+	static const double      sMaxRetryDelay;
+
+	SensorFusion             mFusion;
+	JointFrame               mFusedFrame;
+	std::vector< SkeletonSource::Event > mFusionEvents;
+	static const double      sMaxSensorLag; // frames older than the newest one by more are not fused
+
+	std::thread              mStrokeThread;
+	std::mutex               mStrokeMutex;
+	std::condition_variable  mStrokeCond;
+	bool                     mStrokeJob;   // the stroke thread has work to do
+	bool                     mStrokeBuilt; // the back geometry batch is ready to draw
+	bool                     mStrokeQuit;
+	int                      mStrokeSteps;
+	float                    mStrokeAlpha;
+	double                   mStrokeStepTime;
+	double                   mStrokeTime; // simulation time
+	StrokeBatch              mStrokeBatches[ 2 ]; // built by the stroke thread, drawn by the gl thread
+	int                      mStrokeFront;
+	void                     strokeThread();
+	void                     step();
+
+	StrokeRecorder           mRecorder; // has to outlive the users
+	JointStreamWriter        mJointRecorder;
 
 	Users                    mUsers;
 
+	std::vector< UserRef >   mUserPool;
+	size_t                   mUserPoolSize;
+	static const size_t      sUserPoolSize; // initial pool size
+
+	std::thread              mReclaimThread;
+	std::mutex               mReclaimMutex;
+	std::condition_variable  mReclaimCond;
+	std::vector< UserRef >   mReclaimUsers;
+	std::vector< SensorRef > mReclaimSensors; // stopped, their threads are joined on the reclaim thread
+	bool                     mReclaimQuit;
+
 	friend class User;
 };
 
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vector>
+
+#include "cinder/Thread.h"
+
+#include "NIBackend.h"
+#include "SkeletonSource.h"
+
+//! Skeletons of the OpenNI user tracker, from a device or an .oni recording.
+class OpenNISource : public SkeletonSource, mndl::ni::UserTracker::Listener
+{
+	public:
+		//! Opens the device with the index \a device if \a path is empty, the recording at \a path otherwise.
+		OpenNISource( const ci::fs::path &path = "", int device = 0 );
+
+		bool open();
+		bool read( JointFrame *frame, std::vector< Event > *events );
+		void readVideo( StreamTexture &video );
+		void setMirrored( bool mirrored );
+		//! A device that is unplugged just stops sending frames.
+		double getLostTimeout() const { return mPath.empty() ? 2.0 : 0.0; }
+
+		void newUser       ( mndl::ni::UserTracker::UserEvent event );
+		void lostUser      ( mndl::ni::UserTracker::UserEvent event );
+		void calibrationBeg( mndl::ni::UserTracker::UserEvent event );
+		void calibrationEnd( mndl::ni::UserTracker::UserEvent event );
+
+	private:
+		ci::fs::path            mPath;
+		int                     mDevice;
+
+		mndl::ni::OpenNI        mNI;
+		mndl::ni::UserTracker   mNIUserTracker;
+
+		std::mutex              mEventMutex; // guards the user events of the OpenNI callbacks
+		std::vector< Event >    mEvents;
+		std::vector< unsigned > mTrackedUsers;
+};
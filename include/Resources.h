@@ -5,4 +5,7 @@
 #define RES_STROKE_FRAG CINDER_RESOURCE( ../resources/, shaders/Stroke.frag, 129, GLSL )
 #define RES_KALEIDOSCOPE_VERT CINDER_RESOURCE( ../resources/, shaders/Kaleidoscope.vert, 130, GLSL )
 #define RES_KALEIDOSCOPE_FRAG CINDER_RESOURCE( ../resources/, shaders/Kaleidoscope.frag, 131, GLSL )
+#define RES_STROKE_RIBBON_VERT CINDER_RESOURCE( ../resources/, shaders/StrokeRibbon.vert, 132, GLSL )
+#define RES_STROKE_RIBBON_FRAG CINDER_RESOURCE( ../resources/, shaders/StrokeRibbon.frag, 133, GLSL )
+#define RES_STROKE_BRUSH_VERT CINDER_RESOURCE( ../resources/, shaders/StrokeBrush.vert, 134, GLSL )
 
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+
+#include "cinder/Rect.h"
+#include "cinder/Vector.h"
+
+#include "JointStream.h"
+#include "JointTable.h"
+#include "SkeletonSource.h"
+
+/** Merges the skeletons of several sensors into one stage. The joints of
+ *  the sensors are mapped to stage coordinates by their Extrinsics. A user
+ *  seen by a sensor is bound to a fused user on its first frame, to the
+ *  nearest fused user of the other sensors if the torsos are closer than
+ *  the fusion distance, to a new one otherwise. The joints of a fused user
+ *  are averaged over its sensors weighted by the confidence. The fused user
+ *  is lost with the last sensor user bound to it.
+ */
+class SensorFusion
+{
+	public:
+		//! Placement of a sensor image in the stage.
+		struct Extrinsics
+		{
+			Extrinsics();
+			/** Moves the sensor image by \a offset, scales it by \a scale and rotates it by
+			 *  \a rotation radians around its center.
+			 */
+			Extrinsics( ci::Vec2f offset, float scale, float rotation );
+
+			bool operator==( const Extrinsics &o ) const { return ( origin == o.origin ) && ( axisX == o.axisX ) && ( axisY == o.axisY ); }
+			bool operator!=( const Extrinsics &o ) const { return ! ( *this == o ); }
+
+			//! Maps \a pos in kinect image coordinates to the stage.
+			ci::Vec2f map( ci::Vec2f pos ) const { return origin + pos.x * axisX + pos.y * axisY; }
+			//! Returns the bounds of the sensor image in the stage.
+			ci::Rectf getBounds() const;
+
+			ci::Vec2f origin; // stage position of the image origin
+			ci::Vec2f axisX;
+			ci::Vec2f axisY;
+		};
+
+		SensorFusion();
+
+		//! Sets the number of sensors, forgets all users.
+		void setSensorCount( int count );
+		int  getSensorCount() const { return int( mFrames.size() ); }
+
+		//! Sets the largest distance of the torsos of the same performer seen by two sensors in stage pixels.
+		void setDistance( float distance ) { mDistance = distance; }
+
+		//! Forgets the user \a userId of \a sensor, the fused user lost with it is appended to \a events.
+		void lostUser( int sensor, unsigned userId, std::vector< SkeletonSource::Event > *events );
+		//! Sets the last frame of \a sensor, its joints are in stage coordinates.
+		void setFrame( int sensor, const JointFrame &frame );
+
+		/** Merges the last frames of the sensors into \a frame with the fused user ids, the frames
+		 *  older than \a maxAge seconds than the newest one are left out. The new fused users are
+		 *  appended to \a events.
+		 */
+		void fuse( JointFrame *frame, std::vector< SkeletonSource::Event > *events, double maxAge );
+
+	private:
+		struct Binding
+		{
+			int      sensor;
+			unsigned userId;
+			unsigned fusedId;
+		};
+
+		struct FusedUser
+		{
+			unsigned  id;
+			ci::Vec2f sum[ JointTable::sCount ];    // positions weighted by the confidence
+			float     weight[ JointTable::sCount ]; // sum of the confidences
+			float     confidence[ JointTable::sCount ];
+		};
+
+		/** Unbinds the users whose torso is farther than the fusion distance from the torso of the
+		 *  fused user they are bound to, the frames older than \a oldest are left out.
+		 */
+		void           splitBindings( double oldest );
+		//! Returns the tracked torso of the user joints from \a begin to \a end, \a end if there is none.
+		static std::vector< JointFrame::Joint >::const_iterator findTorso( std::vector< JointFrame::Joint >::const_iterator begin,
+																		   std::vector< JointFrame::Joint >::const_iterator end );
+		const Binding *findBinding( int sensor, unsigned userId ) const;
+		bool           isBound( int sensor, unsigned fusedId ) const;
+		FusedUser     &getFusedUser( unsigned fusedId );
+		//! Returns the fused user nearest to \a torso without a user of \a sensor within the distance, NULL if there is none.
+		FusedUser     *findNearest( int sensor, ci::Vec2f torso );
+		//! Adds the joints of \a frame from \a begin to \a end to \a user.
+		void           accumulate( FusedUser &user, std::vector< JointFrame::Joint >::const_iterator begin,
+								   std::vector< JointFrame::Joint >::const_iterator end );
+
+		std::vector< JointFrame > mFrames; // last frame of each sensor
+		std::vector< Binding >    mBindings;
+		std::vector< FusedUser >  mFused;  // users of the last fused frame
+		std::vector< ci::Vec2f >  mTorsos; // torso of each binding in the current frames
+		std::vector< char >       mTorsoValid;
+		unsigned                  mNextId;
+		float                     mDistance;
+};
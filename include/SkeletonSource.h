@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cinder/Filesystem.h"
+
+#include "JointStream.h"
+#include "StreamTexture.h"
+
+class SkeletonSource;
+typedef std::shared_ptr< SkeletonSource > SkeletonSourceRef;
+
+/** Skeleton input of the UserManager. A source is opened and read on the
+ *  tracking thread only. It reports the users coming and going and the joint
+ *  frames of its users in kinect image coordinates, stamped with the time of
+ *  acquisition on the app clock.
+ */
+class SkeletonSource
+{
+	public:
+		enum Type
+		{
+			SOURCE_DEVICE = 0, // live OpenNI device
+			SOURCE_RECORDING,  // OpenNI .oni recording
+			SOURCE_JOINT_STREAM, // joint stream recorded by JointStreamWriter
+			SOURCE_SYNTHETIC,  // generated users, needs no device
+			SOURCE_COUNT
+		};
+
+		enum EventType
+		{
+			USER_NEW,
+			USER_LOST
+		};
+		typedef std::pair< EventType, unsigned > Event;
+
+		/** Creates a source of \a type, \a path is the file of the recording and joint stream sources,
+		 *  \a device the index of the device source.
+		 */
+		static SkeletonSourceRef create( Type type, const ci::fs::path &path = "", int device = 0 );
+		static const char *sTypeNames[ SOURCE_COUNT ];
+
+		virtual ~SkeletonSource() {}
+
+		//! Opens the device or file, returns false if it is not available, see getStatus.
+		virtual bool open() = 0;
+		//! Returns the state of the source for the params, set by open.
+		const std::string &getStatus() const { return mStatus; }
+
+		/** Appends the user events since the last call to \a events and reads the next
+		 *  frame to \a frame. Returns false if there is no new frame yet, the events
+		 *  are valid anyway.
+		 */
+		virtual bool read( JointFrame *frame, std::vector< Event > *events ) = 0;
+
+		/** Returns the time without frames after which the source is considered lost and
+		 *  opened again, 0 if it cannot get lost.
+		 */
+		virtual double getLostTimeout() const { return 0.0; }
+
+		//! Writes the new video image to \a video, if the source has video.
+		virtual void readVideo( StreamTexture &video ) {}
+		virtual void setMirrored( bool mirrored ) {}
+
+	protected:
+		std::string mStatus;
+};
+
+//! Plays a joint stream in real time, looping at its end.
+class JointStreamSource : public SkeletonSource
+{
+	public:
+		JointStreamSource( const ci::fs::path &path );
+
+		bool open();
+		bool read( JointFrame *frame, std::vector< Event > *events );
+
+	private:
+		bool rewind();
+
+		ci::fs::path                         mPath;
+		std::shared_ptr< JointStreamReader > mReader;
+		JointFrame                           mNextFrame;
+		double                               mStartTime; // app time of the stream start
+		bool                                 mRewound;   // the users of the last pass are lost
+		std::vector< unsigned >              mUsers;     // users of the last frame
+		std::vector< unsigned >              mFrameUsers;
+};
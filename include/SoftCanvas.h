@@ -0,0 +1,105 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "cinder/Surface.h"
+#include "cinder/Thread.h"
+#include "cinder/Vector.h"
+
+#include "BrushArray.h"
+#include "NIUser.h"
+#include "StrokeBatch.h"
+
+/** Cpu implementation of the Canvas pipeline for golden-image tests and
+ *  machines without gl. The stroke ribbons are rasterized with bilinear
+ *  filtering and alpha blending like StrokeBrush.vert and StrokeRibbon.frag,
+ *  then blended with the faded canvas like Stroke.frag. The kaleidoscope is
+ *  not supported.
+ *
+ *  The canvas is split into tiles rendered by a pool of threads, the rgba
+ *  pixels are processed as SSE vectors if available. The result matches the
+ *  gl canvas up to the filtering precision of the gpu and the coverage of
+ *  pixel centers lying exactly on triangle edges.
+ */
+class SoftCanvas
+{
+	public:
+		SoftCanvas();
+		~SoftCanvas();
+
+		//! Allocates a white canvas, the tiles are rendered by \a threadCount threads, 0 uses all cores.
+		void setup( int width, int height, size_t threadCount = 0 );
+		//! Copies the brush images, the index is the layer.
+		void setBrushes( const BrushArray &brushes );
+		void clear();
+
+		//! Draws the strokes of \a userManager, the brushes are copied the first time.
+		void draw( ci::UserManager &userManager, float fadeout, int blendmode );
+		//! Rasterizes the segments of \a batch and blends them with the canvas faded by \a fadeout.
+		void draw( const StrokeBatch &batch, float fadeout, int blendmode );
+
+		//! Returns the canvas with the top row first, like a screenshot of the gl canvas.
+		ci::Surface32f getSurface() const;
+		ci::Vec2i getSize() const { return mSize; }
+
+		//! Returns the largest difference between the rgb channels of \a a and \a b.
+		static float getMaxDifference( const ci::Surface32f &a, const ci::Surface32f &b );
+
+	private:
+		SoftCanvas( const SoftCanvas & );
+		SoftCanvas &operator=( const SoftCanvas & );
+
+		struct Brush
+		{
+			int                  width;
+			int                  height;
+			std::vector< float > texels; // rgba, top row first like the texture
+		};
+
+		// triangle set up for rasterization in pixel coordinates, bottom row first
+		struct Triangle
+		{
+			float edge[ 3 ][ 3 ]; // a, b, c of the counterclockwise edge functions a * x + b * y + c
+			bool  topLeft[ 3 ];   // pixel centers exactly on the edge are covered
+			float u[ 3 ];         // plane equations of the texture coordinates
+			float v[ 3 ];
+			int   layer;
+			int   x0, y0, x1, y1; // pixel bounds, the ends are exclusive
+		};
+
+		void addTriangle( const StrokeBatch::RibbonVertex *vertices );
+
+		void stopThreads();
+		void workerThread();
+		void renderTiles( float *strokes );
+		void renderTile( size_t tile, float *strokes );
+		void rasterize( const Triangle &triangle, int x0, int y0, int x1, int y1, int tileX, int tileY, float *strokes );
+
+		ci::Vec2i              mSize;
+		std::vector< float >   mCanvas; // rgba, bottom row first like the fbo
+		std::vector< Brush >   mBrushes;
+
+		std::vector< StrokeBatch::RibbonVertex > mVertices;
+		std::vector< Triangle >                  mTriangles;
+
+		int                    mTileCountX;
+		int                    mTileCountY;
+		std::vector< std::vector< uint32_t > > mBins; // triangles of each tile in drawing order
+		std::vector< float >   mStrokes; // stroke layer of a tile rendered by the drawing thread
+
+		// state of the frame being rendered
+		float                  mFadeout;
+		int                    mBlendmode;
+
+		std::vector< std::shared_ptr< std::thread > > mThreads;
+		std::mutex              mMutex;
+		std::condition_variable mStartCond;
+		std::condition_variable mDoneCond;
+		unsigned                mFrame;     // incremented to start the workers
+		size_t                  mNextTile;
+		size_t                  mTilesDone;
+		bool                    mQuit;
+
+		static const int        sTileSize;
+};
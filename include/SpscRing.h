@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <boost/atomic.hpp>
+
+/** Lock-free ring buffer between exactly one producer and one consumer
+ *  thread. The items are allocated once and written and read in place, so
+ *  items owning memory, like vectors, keep their capacity and passing them
+ *  does not allocate.
+ */
+template< typename T >
+class SpscRing
+{
+	public:
+		//! \a capacity is rounded up to a power of two.
+		explicit SpscRing( size_t capacity = 64 )
+		: mHead( 0 )
+		, mTail( 0 )
+		{
+			size_t size = 1;
+			while ( size < capacity )
+				size <<= 1;
+			mItems.resize( size );
+			mMask = size - 1;
+		}
+
+		size_t getCapacity() const { return mItems.size(); }
+
+		//! Producer: returns the item to fill, or NULL if the ring is full.
+		T *beginWrite()
+		{
+			size_t head = mHead.load( boost::memory_order_relaxed );
+			if ( head - mTail.load( boost::memory_order_acquire ) == mItems.size() )
+				return NULL;
+			return &mItems[ head & mMask ];
+		}
+
+		//! Producer: publishes the item returned by beginWrite.
+		void endWrite()
+		{
+			mHead.store( mHead.load( boost::memory_order_relaxed ) + 1, boost::memory_order_release );
+		}
+
+		//! Consumer: returns the oldest published item, or NULL if the ring is empty.
+		T *beginRead()
+		{
+			size_t tail = mTail.load( boost::memory_order_relaxed );
+			if ( tail == mHead.load( boost::memory_order_acquire ) )
+				return NULL;
+			return &mItems[ tail & mMask ];
+		}
+
+		//! Consumer: gives the item returned by beginRead back to the producer.
+		void endRead()
+		{
+			mTail.store( mTail.load( boost::memory_order_relaxed ) + 1, boost::memory_order_release );
+		}
+
+	private:
+		SpscRing( const SpscRing & );
+		SpscRing &operator=( const SpscRing & );
+
+		std::vector< T >        mItems;
+		size_t                  mMask;
+
+		// the indices only grow, written by one side each and kept on separate cache lines
+		boost::atomic< size_t > mHead; // next item to write
+		char                    mPadding[ 64 ];
+		boost::atomic< size_t > mTail; // next item to read
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "cinder/gl/gl.h"
+#include "cinder/gl/Texture.h"
+#include "cinder/gl/Vbo.h"
+#include "cinder/Surface.h"
+#include "cinder/Thread.h"
+#include "cinder/Vector.h"
+
+/** Rgb texture streamed from images of another thread. The gl thread keeps a
+ *  ring of mapped pixel buffer objects, the producer thread copies the images
+ *  into them and the gl thread uploads the newest one to the same texture.
+ *  The upload reads from the buffer, so the driver can do it asynchronously,
+ *  and the images are copied off the gl thread.
+ */
+class StreamTexture
+{
+	public:
+		StreamTexture();
+
+		//! Producer: copies \a surface to a mapped buffer, returns false if the image is dropped because no buffer is ready.
+		bool write( const ci::Surface8u &surface );
+
+		//! Gl thread: uploads the newest image written since the last call and maps the free buffers for the producer.
+		void update();
+
+		//! Returns the texture of the last uploaded image, empty until the first upload.
+		const ci::gl::Texture &getTexture() const { return mTexture; }
+
+	private:
+		StreamTexture( const StreamTexture & );
+		StreamTexture &operator=( const StreamTexture & );
+
+		struct Buffer
+		{
+			enum State
+			{
+				FREE,    // owned by the gl thread
+				MAPPED,  // ready for the producer
+				WRITING, // being filled by the producer
+				FILLED   // ready for the upload
+			};
+
+			Buffer() : state( FREE ), data( NULL ), frame( 0 ) {}
+
+			ci::gl::Vbo pbo;
+			State       state;
+			uint8_t    *data;
+			ci::Vec2i   size;  // image size the buffer is allocated for
+			unsigned    frame; // order of the written images
+		};
+
+		static const int sBufferCount = 3;
+
+		Buffer           mBuffers[ sBufferCount ];
+		std::mutex       mMutex; // guards the buffer states, the image size and the frame counter
+		ci::Vec2i        mImageSize;
+		unsigned         mFrame;
+
+		ci::gl::Texture  mTexture;
+};
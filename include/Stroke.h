@@ -1,29 +1,42 @@
 #pragma once
 
-#include <vector>
-
 #include "cinder/Vector.h"
 #include "cinder/app/App.h"
-#include "cinder/gl/gl.h"
-#include "cinder/gl/Texture.h"
-#include "Calibrate.h"
+
+#include "StrokeBatch.h"
+#include "StrokeEmitter.h"
+#include "StrokePointBuffer.h"
+#include "StrokeRecorder.h"
+#include "StrokeSimulation.h"
 
 class Stroke
 {
 	public:
-		Stroke();
+		//! Uses a slot in \a simulation, if there is one, for batched simulation.
+		Stroke( StrokeSimulation *simulation = NULL );
+		~Stroke();
+
+		//! Starts over as a new stroke like the constructor, for strokes stored in place.
+		void reset( StrokeSimulation *simulation );
+		//! Ends the stroke like the destructor, it is not simulated or recorded anymore.
+		void release();
 
 		void resize( const ci::Vec2i &size );
 
-		void addPos( ci::Vec2f point );
+		//! Sets the target, \a time is when its joint was acquired and is passed on to the batch with the points emitted towards it.
+		void addPos( ci::Vec2f point, double time );
 		void update();
-		void draw( const Calibrate &calibrate, const ci::Vec2f &posRef );
+		/** Adds the segments added since the last build to \a batch. The newest segment is built
+		 *  up to \a alpha, the interpolation factor between the last two simulation steps.
+		 */
+		void buildGeometry( float alpha, StrokeBatch &batch );
 
 		void setActive( bool active );
 
-		void clear() { mPoints.clear(); }
+		void clear();
 
-		void setBrush( ci::gl::Texture brush ) { mBrush = brush; };
+		//! Sets the brush layer of the brush array, no stroke is drawn if it is negative.
+		void setBrush( int layer ) { mBrush = layer; };
 
 		void  setStiffness( float s ) { mK = s; }
 		float getStiffness() { return mK; }
@@ -40,21 +53,39 @@ class Stroke
 		void  setMaxVelocity( float v ) { mMaxVelocity = v; }
 		float getMaxVelocity() const { return mMaxVelocity; }
 
-	private:
-		struct StrokePoint
+		//! Keeps the last \a history points, optionally in 16-bit fixed-point format.
+		void setPointStorage( size_t history, bool quantized ) { mPoints.setup( history, quantized ); }
+
+		//! Emits points adaptively, only where the spring path deviates more than \a tolerance pixels from a chord.
+		void setTessellation( float tolerance, float maxTurnAngle )
 		{
-			StrokePoint( ci::Vec2f _p, ci::Vec2f _w, float _u ) :
-				p( _p ), w( _w ), u( _u ) {}
+			mEmitter.setTolerance( tolerance );
+			mEmitter.setMaxTurnAngle( maxTurnAngle );
+		}
+
+		//! Records the emitted points to \a recorder as the stroke of \a jointId of \a userId.
+		void setRecorder( StrokeRecorder *recorder, unsigned userId, int jointId );
+
+		//! Takes the spring state from the batched simulation instead of stepping it in update.
+		void setBatched( bool batched );
+		bool isBatched() const { return mBatched; }
 
-			ci::Vec2f p;
-			ci::Vec2f w;
-			float u;
-		};
+	private:
+		Stroke( const Stroke & );
+		Stroke &operator=( const Stroke & );
+
+		static const size_t sMaxSegments; // built in one frame
+
+		void clampLastDrawn();
+		void emit( const StrokePoint &sample );
+		void flush();
+		void record( size_t first );
 
 		bool mActive;
 		bool mEmpty; // if it has already a target position or not
 
-		std::vector<StrokePoint> mPoints;
+		StrokePointBuffer mPoints;
+		StrokeEmitter     mEmitter;
 
 		ci::Vec2f mPos;     // spring position
 		ci::Vec2f mTarget;  // target position
@@ -68,9 +99,22 @@ class Stroke
 		float     mMaxVelocity;
 
 		float     mU; // u texture coord
-		size_t    mLastDrawn; // index of the last drawn point
+		size_t    mLastDrawn; // index of the last built point
 
 		ci::Vec2i       mWindowSize;
-		ci::gl::Texture mBrush;
-};
+		int             mBrush; // brush layer
 
+		StrokeSimulation         *mSimulation;
+		size_t                    mSlot;
+		bool                      mBatched;
+
+		bool                      mEmitted;   // emitted a point since the last build
+		double                    mTargetTime; // acquisition time of the target joint
+		double                    mEmitTime;   // acquisition time of the target of the last emitted point
+		bool                      mHeadValid; // the last point is replaced by mHead while building
+		StrokePoint               mHead;
+
+		StrokeRecorder           *mRecorder;
+		unsigned                  mUserId;
+		int                       mJointId;
+};
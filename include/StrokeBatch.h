@@ -0,0 +1,121 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include "cinder/Matrix.h"
+#include "cinder/Vector.h"
+#include "cinder/gl/gl.h"
+#include "cinder/gl/GlslProg.h"
+#include "cinder/gl/Vbo.h"
+
+#include "StrokePointBuffer.h"
+
+/** New stroke segments of all users in one frame, drawn with a single call.
+ *  The strokes are added in drawing order and the geometry is built without
+ *  touching gl, so a batch can be filled on a worker thread and drawn later.
+ *  The brush is a layer of the bound BrushArray. The points stay in stroke
+ *  space, the transformation of each user is applied by the vertex shader.
+ */
+class StrokeBatch
+{
+	public:
+		struct RibbonVertex
+		{
+			ci::Vec2f pos;
+			ci::Vec3f uvl; // u, v, brush layer
+		};
+
+		StrokeBatch();
+
+		//! Creates the gl resources shared by all batches, has to be called from the gl thread.
+		static void setup();
+
+		//! Removes all geometry, the batch is built as a gpu ribbon if \a gpuRibbon is set and supported.
+		void clear( bool gpuRibbon = false );
+		bool empty() const;
+
+		//! Transformation applied to the points added afterwards, it has to be affine.
+		void setTransform( const ci::Matrix44f &transform );
+
+		//! Starts a new stroke drawn with the brush \a layer.
+		void beginStroke( int layer );
+		//! Adds a point to the current stroke, a segment is added from the previous point.
+		void addPoint( const StrokePoint &point );
+
+		//! Notes the acquisition time of the joints shown by the stroke, the newest one is kept.
+		void   addJointTime( double time ) { mJointTime = std::max( mJointTime, time ); }
+		//! Returns the acquisition time of the newest joints in the batch, negative if there are none.
+		double getJointTime() const { return mJointTime; }
+		void   setBuildTime( double time ) { mBuildTime = time; }
+		double getBuildTime() const { return mBuildTime; }
+
+		//! Uploads and draws the segments, the brush array has to be bound to texture unit 0.
+		void draw();
+
+		//! Returns the triangles in drawing order, three vertices each, for cpu rendering.
+		void getTriangles( std::vector< RibbonVertex > *triangles ) const;
+
+	private:
+		// cpu ribbon vertex in stroke space
+		struct Vertex
+		{
+			ci::Vec2f pos;
+			ci::Vec3f uvl;       // u, v, brush layer
+			float     transform; // index in mTransforms
+		};
+
+		// per-instance attributes of a gpu ribbon segment
+		struct Segment
+		{
+			StrokePoint p0;
+			StrokePoint p1;
+			float       layer;
+			float       transform;
+		};
+
+		// geometry drawn by one call, the transforms of a call fit in the uniform array of the shaders
+		struct Range
+		{
+			size_t transform; // first transform
+			size_t index;     // first cpu ribbon index
+			size_t segment;   // first gpu ribbon segment
+		};
+
+		void drawCpuRibbon();
+		void drawGpuRibbon();
+		//! Sets the transforms of \a range in \a shader.
+		void setTransformUniforms( ci::gl::GlslProg &shader, const Range &range );
+
+		//! Returns the ribbon corners of a segment, x is the segment end, y the offset across the width.
+		static std::vector< ci::Vec2f > getCorners();
+
+		bool          mGpuRibbon;
+		float         mLayer;
+		bool          mHasPoint;  // the current stroke has a previous point
+		StrokePoint   mLastPoint;
+		double        mJointTime;
+		double        mBuildTime;
+
+		std::vector<ci::Matrix44f> mTransforms;
+		std::vector<Range>        mRanges;
+
+		// cpu ribbon, every point is expanded to sRowCount vertices across the stroke width
+		std::vector<Vertex>       mVertices;
+		std::vector<GLuint>       mIndices;
+		ci::gl::Vbo               mVbo;
+		ci::gl::Vbo               mIndexVbo;
+
+		// gpu ribbon, the vertex shader expands the segments
+		std::vector<Segment>      mSegments;
+		ci::gl::Vbo               mSegmentVbo;
+
+		static const size_t       sSubdivCount;
+		static const size_t       sRowCount;
+		static const size_t       sIndicesPerSegment;
+		static const size_t       sMaxTransforms; // in one draw call
+
+		static ci::gl::Vbo        sCornerVbo; // ribbon corners of one segment
+		static ci::gl::GlslProg   sBrushShader;
+		static ci::gl::GlslProg   sRibbonShader;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <vector>
+
+#include "StrokePointBuffer.h"
+
+/** Adaptive resampling of the spring path. Spring samples are collected until
+ *  the chord from the last emitted point no longer approximates them within
+ *  the tolerance or a few samples are pending, so straight movements emit
+ *  fewer points without drawing the head late. Sharp turns between emitted
+ *  points are refined with Catmull-Rom subdivision, so tight curls get dense
+ *  points even if the spring moves a lot in a step.
+ */
+class StrokeEmitter
+{
+	public:
+		StrokeEmitter();
+
+		//! Sets the maximum distance in pixels of a sample from the emitted path, 0 emits every sample.
+		void  setTolerance( float tolerance ) { mTolerance = tolerance; }
+		float getTolerance() const { return mTolerance; }
+
+		//! Sets the maximum turning angle in radians between emitted segments, 0 turns off subdivision.
+		void  setMaxTurnAngle( float angle ) { mMaxTurnAngle = angle; }
+		float getMaxTurnAngle() const { return mMaxTurnAngle; }
+
+		void reset();
+
+		//! Adds a spring sample, emits the points needed to stay within tolerance to \a points.
+		void add( const StrokePoint &sample, StrokePointBuffer &points );
+		//! Emits the last pending sample, if there is one.
+		void flush( StrokePointBuffer &points );
+
+	private:
+		bool fits( const StrokePoint &end ) const;
+		void emit( const StrokePoint &point, StrokePointBuffer &points );
+
+		float mTolerance;
+		float mMaxTurnAngle;
+
+		std::vector< StrokePoint > mPending; // samples since the last emitted point
+
+		size_t      mEmittedCount; // 0, 1 or 2 if there are at least two emitted points
+		StrokePoint mLast;         // last emitted point
+		StrokePoint mPrev;         // point emitted before mLast
+
+		static const size_t sMaxPending;
+		static const int    sMaxSubdivisions;
+};
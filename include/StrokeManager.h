@@ -3,40 +3,76 @@
 #include <map>
 
 #include "cinder/app/App.h"
-#include "cinder/gl/Texture.h"
 #include "cinder/Vector.h"
 
+#include "JointTable.h"
 #include "Stroke.h"
+#include "StrokeRecorder.h"
+#include "StrokeSimulation.h"
 #include "PParams.h"
-#include "Calibrate.h"
 
+/** Strokes of a user indexed by id. The strokes of the stroke joints of
+ *  JointTable are stored in place in a table indexed by their joint slot,
+ *  other ids, like the generated ones, are allocated separately. The table is
+ *  updated and drawn first in the order of the slots, then the other strokes
+ *  in the order of the ids.
+ */
 class StrokeManager
 {
 typedef std::shared_ptr< Stroke > StrokeRef;
 typedef std::map< int, StrokeRef > Strokes;
 
 public:
-	static void setup( ci::Vec2i size );
+	StrokeManager();
+
+	//! Sets up the params, without \a gl the shaders of the stroke batches are not loaded.
+	static void setup( ci::Vec2i size, bool gl = true );
+	//! Steps the batched simulation of all strokes, has to be called before update.
+	static void simulate();
+	//! Returns if the strokes are expanded to ribbons in a vertex shader.
+	static bool getGpuRibbon() { return mGpuRibbon; }
 
 	void update();
-	void draw( const Calibrate &calibrate, const ci::Vec2f &posRef );
+	//! Adds the new segments of all strokes to \a batch, see Stroke::buildGeometry.
+	void buildGeometry( float alpha, StrokeBatch &batch );
 
-	void addPos( int id, ci::Vec2f pos );
+	//! See Stroke::addPos.
+	void addPos( int id, ci::Vec2f pos, double time );
 	void setActive( int id, bool active );
-	void setBrush( int id, ci::gl::Texture brush );
+	void setBrush( int id, int layer );
 	void clear();
 
 	int  createStroke ( int id = -1 );
 	void destroyStroke( int id );
+	//! Destroys all strokes, the table keeps their point storage for reuse.
+	void destroyStrokes();
+	//! Allocates the point storage of the table stroke \a id, so creating it later does not allocate.
+	void reserve( int id );
+
+	//! Records the strokes to \a recorder as the strokes of \a userId.
+	void setRecorder( StrokeRecorder *recorder, unsigned userId );
 
 private:
-	StrokeRef findStroke( int id );
+	StrokeManager( const StrokeManager & );
+	StrokeManager &operator=( const StrokeManager & );
+
+	Stroke   *findStroke( int id );
+	//! Returns the table slot of the stroke \a id, -1 if it is not stored in the table.
+	static int getSlot( int id );
 	int       generateStrokeId();
+	void      updateStroke( Stroke &stroke );
 
 private:
-	Strokes                  mStrokes;
+	static const int         sSlotCount = JointTable::sStrokeCount;
+
+	Stroke                   mSlots[ sSlotCount ];
+	bool                     mSlotUsed[ sSlotCount ];
+	Strokes                  mStrokes; // ids outside of the slots
+	StrokeRecorder          *mRecorder;
+	unsigned                 mUserId;
 
 	static const int         sGenerateid;
+	static StrokeSimulation  sSimulation;
 
 	// params
 	static mndl::params::PInterfaceGl mParams;
@@ -45,6 +81,12 @@ private:
 	static float                    mStrokeMinWidth;
 	static float                    mStrokeMaxWidth;
 	static float                    mMaxVelocity;
+	static bool                     mGpuRibbon;
+	static int                      mPointHistory;
+	static bool                     mPointQuantized;
+	static bool                     mBatchedSimulation;
+	static float                    mTessellationTolerance;
+	static float                    mTessellationAngle;
 	static ci::Vec2i                mSize;
 };
 
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "cinder/Cinder.h"
+#include "cinder/Vector.h"
+
+struct StrokePoint
+{
+	StrokePoint() {}
+	StrokePoint( ci::Vec2f _p, ci::Vec2f _w, float _u ) :
+		p( _p ), w( _w ), u( _u ) {}
+
+	ci::Vec2f p; // position in pixels
+	ci::Vec2f w; // half width vector perpendicular to the stroke
+	float u;     // u texture coord
+};
+
+/** Bounded storage of stroke points. Points are indexed by their absolute
+ *  index since the last clear, but only the last \a capacity points are kept,
+ *  older ones are overwritten. The storage is allocated once, so memory stays
+ *  flat no matter how long the stroke gets.
+ *
+ *  In quantized mode the points are stored as 16-bit fixed-point values,
+ *  positions with 1/8 pixel precision in the range of +-4096 pixels, widths
+ *  with 1/32 pixel precision in +-1024 pixels. The u coordinate is stored
+ *  modulo 64 with 1/1024 precision and it is unwrapped relative to the last
+ *  point, so points within 64 texture repeats of the last one decode
+ *  consistently.
+ */
+class StrokePointBuffer
+{
+	public:
+		StrokePointBuffer( size_t capacity = 1024, bool quantized = false );
+
+		//! Sets capacity and encoding, keeps the last points that fit.
+		void setup( size_t capacity, bool quantized );
+
+		size_t getCapacity() const { return mCapacity; }
+		bool   isQuantized() const { return mQuantized; }
+
+		void push_back( const StrokePoint &point );
+		void clear();
+
+		bool   empty() const { return mSize == 0; }
+		//! Returns the number of points added since the last clear.
+		size_t size() const { return mSize; }
+		//! Returns the index of the oldest point still stored.
+		size_t getFirst() const { return ( mSize > mCapacity ) ? mSize - mCapacity : 0; }
+
+		//! Returns the point at absolute index \a i, which has to be in [getFirst(), size()).
+		StrokePoint operator[]( size_t i ) const;
+		StrokePoint back() const { return (*this)[ mSize - 1 ]; }
+
+		//! Decodes \a count points starting at absolute index \a first to \a out.
+		void copy( size_t first, size_t count, StrokePoint *out ) const;
+
+	private:
+		struct QuantizedPoint
+		{
+			int16_t  px, py;
+			int16_t  wx, wy;
+			uint16_t u;
+		};
+
+		static QuantizedPoint encode( const StrokePoint &point );
+		StrokePoint           decode( const QuantizedPoint &point ) const;
+
+		size_t mCapacity;
+		bool   mQuantized;
+		size_t mSize;
+		float  mLastU; // u of the last point unquantized
+
+		std::vector< StrokePoint >    mPoints;
+		std::vector< QuantizedPoint > mQuantizedPoints;
+};
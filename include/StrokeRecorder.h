@@ -0,0 +1,148 @@
+#pragma once
+
+#include <stdint.h>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cinder/Filesystem.h"
+#include "cinder/Thread.h"
+
+#include "StrokePointBuffer.h"
+
+/** Streaming binary recording of the emitted stroke points.
+ *
+ *  The file starts with the magic "PRST", a version byte and the quantization
+ *  scales of the position, width and u coordinate as floats. It is followed by
+ *  records, each starting with a varint header of ( value << 2 ) | kind:
+ *  - point: value is the stroke index, followed by the zigzag varint residuals
+ *    of the quantized px, py, wx, wy, u from their linear prediction from the
+ *    previous two points of the stroke,
+ *  - begin: value is the stroke index, followed by varint user id, varint joint
+ *    id and zigzag varint brush layer,
+ *  - end: value is the stroke index, which can be reused afterwards,
+ *  - time: value is the milliseconds elapsed since the previous time record.
+ *  Stroke indices are kept small, so most points take six bytes.
+ */
+class StrokeRecorder
+{
+	public:
+		StrokeRecorder();
+		~StrokeRecorder();
+
+		//! Starts recording to \a path on a background thread, throws StrokeRecorderExc if the file cannot be written.
+		void start( const ci::fs::path &path );
+		void stop();
+		bool isRecording() const;
+
+		//! Sets the simulation time of the points added afterwards.
+		void setTime( double seconds );
+		void addPoint( unsigned userId, int jointId, int brush, const StrokePoint &point );
+		void endStroke( unsigned userId, int jointId );
+
+		//! Returns the number of points dropped because the writer could not keep up.
+		size_t getDropped() const;
+
+		static const float sPosScale;
+		static const float sWidthScale;
+		static const float sUScale;
+
+	private:
+		StrokeRecorder( const StrokeRecorder & );
+		StrokeRecorder &operator=( const StrokeRecorder & );
+
+		struct Event
+		{
+			bool        end;
+			unsigned    userId;
+			int         jointId;
+			int         brush;
+			double      time;
+			StrokePoint point;
+		};
+
+		struct Track
+		{
+			uint32_t index;
+			int      brush;
+			int      count;
+			int32_t  q[ 2 ][ 5 ]; // last two quantized points
+		};
+
+		typedef std::pair< unsigned, int > TrackKey;
+
+		void writeThread();
+		void encode( const Event &event );
+		void endTrack( std::map< TrackKey, Track >::iterator it );
+
+		mutable std::mutex           mMutex;
+		std::condition_variable      mCond;
+		std::thread                  mThread;
+		bool                         mRecording;
+		double                       mTime;
+		size_t                       mDropped;
+		std::vector< Event >         mPending; // bounded by sQueueCapacity
+
+		static const size_t          sQueueCapacity;
+
+		// only used by the writer thread
+		std::ofstream                mFile;
+		std::vector< uint8_t >       mBuffer;
+		std::map< TrackKey, Track >  mTracks;
+		std::vector< bool >          mIndexUsed;
+		int64_t                      mLastMs;
+};
+
+//! Decodes a stroke recording, see StrokeRecorder for the format.
+class StrokeRecordReader
+{
+	public:
+		struct Event
+		{
+			bool        end; // the stroke ended, point is not valid
+			double      time;
+			unsigned    userId;
+			int         jointId;
+			int         brush;
+			StrokePoint point;
+		};
+
+		//! Opens \a path, throws StrokeRecorderExc if it is not a stroke recording.
+		StrokeRecordReader( const ci::fs::path &path );
+
+		//! Reads the next point or stroke end, returns false at the end of the file.
+		bool read( Event *event );
+
+	private:
+		struct Track
+		{
+			unsigned userId;
+			int      jointId;
+			int      brush;
+			int      count;
+			int32_t  q[ 2 ][ 5 ];
+		};
+
+		bool readVarint( uint64_t *value );
+
+		std::ifstream         mFile;
+		float                 mPosScale;
+		float                 mWidthScale;
+		float                 mUScale;
+		int64_t               mMs;
+		std::vector< Track >  mTracks;
+};
+
+class StrokeRecorderExc : public std::exception
+{
+	public:
+		StrokeRecorderExc( const std::string &message ) throw() : mMessage( message ) {}
+		virtual ~StrokeRecorderExc() throw() {}
+		virtual const char *what() const throw() { return mMessage.c_str(); }
+
+	private:
+		std::string mMessage;
+};
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <vector>
+
+#include "cinder/Vector.h"
+
+#include "StrokePointBuffer.h"
+
+/** Spring simulation of many strokes at once. The state of every stroke is
+ *  kept in structure-of-arrays form and all of them are stepped together with
+ *  SSE/AVX kernels if available. The kernels do the same float operations in
+ *  the same order as the scalar Stroke::update, so the results match unless
+ *  the compiler contracts the scalar multiply-adds to FMA instructions. Debug
+ *  builds check this on a few springs with the first step. Every stroke owns a
+ *  slot, the simulation parameters are shared.
+ */
+class StrokeSimulation
+{
+	public:
+		StrokeSimulation();
+
+		size_t allocate();
+		void   release( size_t slot );
+
+		void setTarget( size_t slot, const ci::Vec2f &target );
+		void setActive( size_t slot, bool active );
+		//! Forgets the points of the stroke, it restarts from the target on the next step.
+		void reset( size_t slot );
+
+		void      setState( size_t slot, const ci::Vec2f &pos, const ci::Vec2f &vel, float u, bool started );
+		ci::Vec2f getPos( size_t slot ) const { return ci::Vec2f( mPosX[ slot ], mPosY[ slot ] ); }
+		ci::Vec2f getVel( size_t slot ) const { return ci::Vec2f( mVelX[ slot ], mVelY[ slot ] ); }
+		float     getU  ( size_t slot ) const { return mU[ slot ]; }
+
+		void setParams( float k, float damping, float mass,
+						float strokeMinWidth, float strokeMaxWidth, float maxVelocity,
+						const ci::Vec2i &size );
+
+		//! Steps all strokes once.
+		void step();
+
+		//! Returns true if the stroke emitted a point in the last step.
+		bool        isEmitted( size_t slot ) const { return mEmitted[ slot ] != 0.f; }
+		StrokePoint getPoint ( size_t slot ) const;
+
+	private:
+		void resize( size_t count );
+		void updateRunning( size_t slot );
+		void stepScalar( size_t beg, size_t end );
+		//! Steps with the widest kernel available, with the scalar step otherwise.
+		void stepVector( size_t beg, size_t end );
+		//! Steps a few springs with stepVector and stepScalar and reports if they differ.
+		void checkKernel() const;
+
+		template< typename Ops >
+		void stepKernel( size_t beg, size_t end );
+
+		size_t                mCount; // number of slots, multiple of the widest kernel
+		std::vector< size_t > mFreeSlots;
+
+		// state
+		std::vector< float > mPosX, mPosY;
+		std::vector< float > mTargetX, mTargetY;
+		std::vector< float > mVelX, mVelY;
+		std::vector< float > mU;
+		std::vector< float > mRunning; // active and has a target, 0 or 1
+		std::vector< float > mStarted; // has points already, 0 or 1
+		std::vector< bool >  mActive;
+		std::vector< bool >  mHasTarget;
+
+		// output of the last step
+		std::vector< float > mEmitted;
+		std::vector< float > mPointX, mPointY;
+		std::vector< float > mWidthX, mWidthY;
+
+		// params
+		float     mK;
+		float     mDamping;
+		float     mMass;
+		float     mStrokeMinWidth;
+		float     mStrokeMaxWidth;
+		float     mMaxVelocity;
+		ci::Vec2f mSize;
+};
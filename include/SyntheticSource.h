@@ -0,0 +1,90 @@
+#pragma once
+
+#include <vector>
+
+#include "cinder/Rand.h"
+#include "cinder/Vector.h"
+
+#include "SkeletonSource.h"
+
+/** Generated users for load testing without a device, beyond the users a
+ *  sensor can track. The users walk around and move their arms and legs
+ *  as limbs of fixed length, driven by smooth random motion. They leave
+ *  at random at the churn rate and are replaced by new users, so the user
+ *  count stays constant. The same seed generates the same users and motion
+ *  as long as the frames are read in time.
+ */
+class SyntheticSource : public SkeletonSource
+{
+	public:
+		struct Options
+		{
+			Options() : userCount( 2 ), churn( 0.f ), seed( 1 ), frameRate( 30.f ) {}
+
+			bool operator==( const Options &o ) const
+			{
+				return ( userCount == o.userCount ) && ( churn == o.churn ) && ( seed == o.seed ) && ( frameRate == o.frameRate );
+			}
+			bool operator!=( const Options &o ) const { return ! ( *this == o ); }
+
+			int   userCount; // users at the same time
+			float churn;     // users leaving per second, each is replaced by a new one
+			int   seed;
+			float frameRate;
+		};
+
+		SyntheticSource( const Options &options = Options() );
+
+		bool open();
+		bool read( JointFrame *frame, std::vector< Event > *events );
+
+	private:
+		// smooth random motion between -1 and 1, the sum of two sines
+		struct Wave
+		{
+			float freq[ 2 ];
+			float phase[ 2 ];
+
+			float operator()( float time ) const;
+		};
+
+		enum Motion
+		{
+			MOTION_LEAN = 0,
+			MOTION_HEAD,
+			MOTION_LEFT_SHOULDER,
+			MOTION_LEFT_ELBOW,
+			MOTION_RIGHT_SHOULDER,
+			MOTION_RIGHT_ELBOW,
+			MOTION_KNEES,
+			MOTION_COUNT
+		};
+
+		struct Body
+		{
+			unsigned id;
+			float    scale;   // smaller further from the sensor
+			float    x;       // torso position
+			float    targetX; // where it walks to
+			float    speed;   // walking speed in pixels per second
+			float    gait;    // phase of the steps
+			float    stride;  // swing of the legs, 0 while standing
+			Wave     waves[ MOTION_COUNT ];
+		};
+
+		//! Creates a new user at a random place, adds its event to \a events.
+		void addBody( std::vector< Event > *events );
+		void moveBody( Body &body, float dt );
+		//! Adds the joints of \a body to \a frame at \a time seconds.
+		void addJoints( JointFrame *frame, const Body &body, float time );
+
+		Options             mOptions;
+		ci::Rand            mRand;
+		std::vector< Body > mBodies;
+		unsigned            mNextId;
+		double              mFramePeriod;
+		double              mStartTime;
+		double              mNextTime;
+		double              mLastTime;
+		bool                mStarted;
+};
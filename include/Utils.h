@@ -3,14 +3,16 @@
 #include <string>
 #include <vector>
 
-#include "cinder/gl/Texture.h"
 #include "cinder/Filesystem.h"
+#include "cinder/Matrix.h"
+#include "cinder/Rect.h"
 
 namespace cinder {
 
 //! Returns time stamp for current time.
 std::string timeStamp();
 
-std::vector< std::pair< std::string, ci::gl::Texture > > loadTextures( const fs::path &relativeDir );
+//! Returns the affine matrix of RectMapping( \a srcRect, \a dstRect ).
+ci::Matrix44f getRectMappingMatrix( const ci::Rectf &srcRect, const ci::Rectf &dstRect );
 
 } // namespace cinder
@@ -0,0 +1,19 @@
+#version 120
+
+// stroke space to the canvas, one for each user, see StrokeBatch::sMaxTransforms
+uniform mat4 transforms[ 16 ];
+// batch index of transforms[ 0 ]
+uniform float transformBase;
+
+// batch index of the transform of the vertex
+attribute float transform;
+
+// texture coordinates: u, v, brush layer
+void main()
+{
+	mat4 m = transforms[ int( transform - transformBase + .5 ) ];
+
+	gl_FrontColor = gl_Color;
+	gl_TexCoord[ 0 ] = gl_MultiTexCoord0;
+	gl_Position = gl_ModelViewProjectionMatrix * m * gl_Vertex;
+}
@@ -0,0 +1,9 @@
+#version 120
+#extension GL_EXT_texture_array : require
+
+uniform sampler2DArray brushes;
+
+void main()
+{
+	gl_FragColor = gl_Color * texture2DArray( brushes, gl_TexCoord[ 0 ].stp );
+}
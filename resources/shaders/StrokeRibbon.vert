@@ -0,0 +1,35 @@
+#version 120
+
+// ribbon corner, x: segment end (0 or 1), y: offset across the width [-1, 1]
+attribute vec2 corner;
+
+// stroke points at the beginning and at the end of the segment
+attribute vec2 p0;
+attribute vec2 w0;
+attribute float u0;
+attribute vec2 p1;
+attribute vec2 w1;
+attribute float u1;
+
+// brush texture array layer
+attribute float layer;
+
+// stroke space to the canvas, one for each user, see StrokeBatch::sMaxTransforms
+uniform mat4 transforms[ 16 ];
+// batch index of transforms[ 0 ]
+uniform float transformBase;
+
+// batch index of the transform of the segment
+attribute float transform;
+
+void main()
+{
+	vec2 p = mix( p0, p1, corner.x );
+	vec2 w = mix( w0, w1, corner.x );
+	float u = mix( u0, u1, corner.x );
+
+	gl_FrontColor = gl_Color;
+	gl_TexCoord[ 0 ] = vec4( u, corner.y * .5 + .5, layer, 1. );
+	mat4 m = transforms[ int( transform - transformBase + .5 ) ];
+	gl_Position = gl_ModelViewProjectionMatrix * m * vec4( p + corner.y * w, 0., 1. );
+}
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Renders the test joint stream with gl and with SoftCanvas and fails if a
+# frame differs more than the tolerance of ProthesisRender --compare.
+#
+# usage: compare.sh path/to/ProthesisRender [output folder]
+
+if [ -z "$1" ]; then
+	echo "usage: compare.sh path/to/ProthesisRender [output folder]"
+	exit 2
+fi
+
+RENDER="$1"
+OUTPUT="${2:-compare}"
+STREAM="$(cd "$(dirname "$0")/../assets/test" && pwd)/compare.prjs"
+
+rm -f "$OUTPUT/compare.txt"
+"$RENDER" --compare "$STREAM" "$OUTPUT" 30
+
+if [ ! -f "$OUTPUT/compare.txt" ]; then
+	echo "no compare report written to $OUTPUT"
+	exit 1
+fi
+
+cat "$OUTPUT/compare.txt"
+tail -n 1 "$OUTPUT/compare.txt" | grep -q "^passed$"
@@ -0,0 +1,89 @@
+#include "cinder/app/App.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Surface.h"
+#include "cinder/ip/Fill.h"
+#include "cinder/ip/Resize.h"
+
+#include "BrushArray.h"
+
+using namespace std;
+using namespace ci;
+using namespace ci::app;
+
+BrushArray::BrushArray()
+: mId( 0 )
+{
+}
+
+BrushArray::~BrushArray()
+{
+	if ( mId )
+		glDeleteTextures( 1, &mId );
+}
+
+void BrushArray::load( const fs::path &relativeDir, bool upload /* = true */ )
+{
+	mSurfaces.clear();
+	mNames.clear();
+
+	fs::path dataPath = getAssetPath( relativeDir );
+
+	for( fs::directory_iterator it( dataPath ); it != fs::directory_iterator(); ++it )
+	{
+		if( fs::is_regular_file(*it) && ( it->path().extension().string() == ".png" ))
+		{
+			Surface8u image( loadImage( loadAsset( relativeDir / it->path().filename())));
+
+			// layers have the same size and rgba channel order
+			if ( mSurfaces.empty() )
+				mSize = image.getSize();
+			else if ( image.getSize() != mSize )
+				image = ip::resizeCopy( image, image.getBounds(), mSize );
+
+			Surface8u rgba( mSize.x, mSize.y, true, SurfaceChannelOrder::RGBA );
+			ip::fill( &rgba, ColorA8u( 0, 0, 0, 255 ) ); // opaque if the image has no alpha
+			rgba.copyFrom( image, image.getBounds() );
+
+			mSurfaces.push_back( rgba );
+			mNames.push_back( it->path().filename().string() );
+		}
+	}
+
+	if ( mSurfaces.empty() || ! upload )
+		return;
+
+	if ( ! mId )
+		glGenTextures( 1, &mId );
+
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, mId );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_S, GL_REPEAT );
+	glTexParameteri( GL_TEXTURE_2D_ARRAY_EXT, GL_TEXTURE_WRAP_T, GL_REPEAT );
+	glTexImage3D( GL_TEXTURE_2D_ARRAY_EXT, 0, GL_RGBA8, mSize.x, mSize.y, (GLsizei)mSurfaces.size(), 0,
+				  GL_RGBA, GL_UNSIGNED_BYTE, NULL );
+
+	for ( size_t i = 0; i < mSurfaces.size(); i++ )
+	{
+		glPixelStorei( GL_UNPACK_ROW_LENGTH, mSurfaces[ i ].getRowBytes() / 4 );
+		glTexSubImage3D( GL_TEXTURE_2D_ARRAY_EXT, 0, 0, 0, (GLint)i, mSize.x, mSize.y, 1,
+						 GL_RGBA, GL_UNSIGNED_BYTE, mSurfaces[ i ].getData() );
+	}
+	glPixelStorei( GL_UNPACK_ROW_LENGTH, 0 );
+
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+}
+
+void BrushArray::bind( GLuint textureUnit /* = 0 */ ) const
+{
+	glActiveTexture( GL_TEXTURE0 + textureUnit );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, mId );
+	glActiveTexture( GL_TEXTURE0 );
+}
+
+void BrushArray::unbind( GLuint textureUnit /* = 0 */ ) const
+{
+	glActiveTexture( GL_TEXTURE0 + textureUnit );
+	glBindTexture( GL_TEXTURE_2D_ARRAY_EXT, 0 );
+	glActiveTexture( GL_TEXTURE0 );
+}
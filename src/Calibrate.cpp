@@ -27,6 +27,9 @@ Calibrate::Calibrate()
 , mCoverRight( 0.f )
 , mCoverTop( 0.f )
 , mCoverBottom( 0.f )
+, mTranslate( Vec2f::zero() )
+, mScale( Vec2f::one() )
+, mVersion( 0 )
 {
 }
 
@@ -64,6 +67,21 @@ void Calibrate::setup()
 	mParams.setOptions( "", "refresh=.3" );
 }
 
+void Calibrate::update()
+{
+	Vec2f translate = getTranslate();
+	Vec2f scale = getScale();
+
+	if ( ( translate == mTranslate ) && ( scale == mScale ) )
+		return;
+
+	mTranslate = translate;
+	mScale = scale;
+	mMatrix = Matrix44f::createTranslation( Vec3f( mTranslate, 0.f ) ) *
+			  Matrix44f::createScale( Vec3f( mScale, 1.f ) );
+	mVersion++;
+}
+
 void Calibrate::mouseDown( MouseEvent event )
 {
 	mMousePos = event.getPos();
@@ -101,12 +119,20 @@ void Calibrate::mouseUp( MouseEvent event )
 
 const Vec2f Calibrate::transform( const Vec2f pos ) const
 {
-	return (( pos * getScale()) + getTranslate());
+	return (( pos * mScale ) + mTranslate );
 }
 
 const Vec2f Calibrate::transform( const Vec2f pos, const Vec2f posRef ) const
 {
-	return ((( pos - posRef ) * getScale()) + getTranslate()) + posRef;
+	return ((( pos - posRef ) * mScale ) + mTranslate ) + posRef;
+}
+
+Matrix44f Calibrate::getMatrix( const Vec2f &posRef ) const
+{
+	// scaling around posRef
+	Vec2f translate = mTranslate + posRef - posRef * mScale;
+	return Matrix44f::createTranslation( Vec3f( translate, 0.f ) ) *
+		   Matrix44f::createScale( Vec3f( mScale, 1.f ) );
 }
 
 const Vec2f Calibrate::getTranslate() const
@@ -0,0 +1,105 @@
+#include "cinder/app/App.h"
+#include "cinder/gl/gl.h"
+
+#include "Canvas.h"
+#include "Resources.h"
+
+using namespace ci;
+using namespace ci::app;
+
+void Canvas::setup( int width, int height )
+{
+	gl::Fbo::Format format;
+	format.enableDepthBuffer( false );
+	// FIXME: enabling MSAA results in white stripes between stroke triangles
+// 	format.setSamples( 4 );
+	format.setColorInternalFormat( GL_RGBA32F_ARB );
+	format.enableColorBuffer( true, 4 );
+	mFbo = gl::Fbo( width, height, format );
+	clear();
+
+	mKaleidoscope = Kaleidoscope::create( mFbo.getWidth(), mFbo.getHeight() );
+
+	try
+	{
+		mBlendShader = gl::GlslProg( loadResource( RES_STROKE_VERT ),
+									 loadResource( RES_STROKE_FRAG ) );
+	}
+	catch( const std::exception &e )
+	{
+		console() << e.what() << std::endl;
+	}
+	mBlendShader.bind();
+	mBlendShader.uniform( "background", 0 );
+	mBlendShader.uniform( "brush", 1 );
+	mBlendShader.unbind();
+}
+
+void Canvas::clear()
+{
+	mFboPingPongId = 1;
+	mFbo.bindFramebuffer();
+	glDrawBuffer( GL_COLOR_ATTACHMENT1_EXT );
+	gl::clear( Color::white() );
+	glDrawBuffer( GL_COLOR_ATTACHMENT2_EXT );
+	gl::clear( Color::white() );
+	mFbo.unbindFramebuffer();
+}
+
+void Canvas::draw( UserManager &userManager, float fadeout, int blendmode )
+{
+	// draw and blend strokes in fbo
+	mFbo.bindFramebuffer();
+	// draw strokes to attachment 0
+	glDrawBuffer( GL_COLOR_ATTACHMENT0_EXT );
+	if ( blendmode == BLENDMODE_DARKEN )
+		gl::clear( ColorA::white() );
+	else // BLENDMODE_ERASE
+		gl::clear( ColorA( 0, 0, 0, 0 ) );
+
+	gl::setMatricesWindow( mFbo.getSize(), false );
+	gl::setViewport( mFbo.getBounds() );
+
+	userManager.drawStroke();
+
+	// blend it with previous frame to attachment pingpongid
+	glDrawBuffer( GL_COLOR_ATTACHMENT0_EXT + mFboPingPongId );
+	gl::color( Color::white() );
+	int otherId = ( mFboPingPongId == 1 ) ? 2 : 1;
+	mBlendShader.bind();
+	mBlendShader.uniform( "fadeout", fadeout );
+	mBlendShader.uniform( "mode", blendmode );
+	mFbo.getTexture( otherId ).bind( 0 ); // bind previous frame to sampler 0
+	mFbo.getTexture( 0 ).bind( 1 ); // bind strokes to sampler 1
+	gl::drawSolidRect( mFbo.getBounds() );
+	mFbo.getTexture( otherId ).unbind();
+	mFbo.getTexture( 0 ).unbind( 1 );
+	mBlendShader.unbind();
+
+	mFbo.unbindFramebuffer();
+
+	// kaleidoscope
+
+	if ( mKaleidoscope->isEnabled() )
+	{
+		gl::Texture processed = mKaleidoscope->process( mFbo.getTexture( mFboPingPongId ) );
+		mFbo.bindFramebuffer();
+		glDrawBuffer( GL_COLOR_ATTACHMENT3 );
+		gl::clear();
+		gl::setViewport( mFbo.getBounds() );
+		gl::setMatricesWindow( mFbo.getSize(), false );
+		gl::color( Color::white() );
+		gl::draw( processed, mFbo.getBounds() );
+		mFbo.unbindFramebuffer();
+	}
+
+	mFboPingPongId = otherId;
+}
+
+gl::Texture Canvas::getTexture( bool processed /* = true */ )
+{
+	if ( processed && mKaleidoscope->isEnabled() )
+		return mFbo.getTexture( 3 );
+	else
+		return mFbo.getTexture( mFboPingPongId == 1 ? 2 : 1 );
+}
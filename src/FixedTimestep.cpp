@@ -0,0 +1,42 @@
+#include "cinder/CinderMath.h"
+
+#include "FixedTimestep.h"
+
+using namespace ci;
+
+FixedTimestep::FixedTimestep( double rate /* = 60.0 */, int maxSteps /* = 8 */ )
+: mRate( rate )
+, mMaxSteps( maxSteps )
+, mAccumulator( 0.0 )
+{
+}
+
+void FixedTimestep::setRate( double rate )
+{
+	if ( rate == mRate )
+		return;
+
+	// keep the accumulated fraction of the step
+	mAccumulator *= mRate / rate;
+	mRate = rate;
+}
+
+int FixedTimestep::advance( double elapsed )
+{
+	double step = getStep();
+
+	mAccumulator += math< double >::max( elapsed, 0.0 );
+	int steps = int( mAccumulator / step );
+	if ( steps > mMaxSteps )
+	{
+		// too slow to keep up, drop the time
+		steps = mMaxSteps;
+		mAccumulator = 0.0;
+	}
+	else
+	{
+		mAccumulator -= steps * step;
+	}
+
+	return steps;
+}
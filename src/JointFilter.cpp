@@ -0,0 +1,316 @@
+#include <algorithm>
+
+#include "cinder/CinderMath.h"
+
+#include "JointFilter.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) )
+#define JOINT_FILTER_SSE 1
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace ci;
+
+namespace {
+
+#if JOINT_FILTER_SSE
+struct SseOps
+{
+	typedef __m128 V;
+	static const size_t sWidth = 4;
+
+	static V    load( const float *p ) { return _mm_loadu_ps( p ); }
+	static void store( float *p, V v ) { _mm_storeu_ps( p, v ); }
+	static V    set( float f ) { return _mm_set1_ps( f ); }
+	static V    add( V a, V b ) { return _mm_add_ps( a, b ); }
+	static V    sub( V a, V b ) { return _mm_sub_ps( a, b ); }
+	static V    mul( V a, V b ) { return _mm_mul_ps( a, b ); }
+	static V    div( V a, V b ) { return _mm_div_ps( a, b ); }
+	static V    sqrt( V a ) { return _mm_sqrt_ps( a ); }
+	static V    and_( V a, V b ) { return _mm_and_ps( a, b ); }
+	static V    or_( V a, V b ) { return _mm_or_ps( a, b ); }
+	static V    gt( V a, V b ) { return _mm_cmpgt_ps( a, b ); }
+	static V    select( V mask, V a, V b ) { return _mm_or_ps( _mm_and_ps( mask, a ), _mm_andnot_ps( mask, b ) ); }
+};
+#endif
+
+} // anonymous namespace
+
+const float  JointFilter::sMinConfidence  = .9f;
+// cutoff of the velocity used to adapt the position cutoff
+const float  JointFilter::sDerivateCutoff = 1.f;
+// longer gaps between frames start all joints again
+const double JointFilter::sMaxGap         = .5;
+
+JointFilter::JointFilter()
+: mCount( 0 )
+, mHasTime( false )
+, mTime( 0.0 )
+{
+	for ( int i = 0; i < JointTable::sCount; i++ )
+	{
+		mMinCutoff[ i ] = JointTable::sJoints[ i ].minCutoff;
+		mBeta[ i ] = JointTable::sJoints[ i ].beta;
+	}
+}
+
+void JointFilter::setParams( int slot, float minCutoff, float beta )
+{
+	mMinCutoff[ slot ] = minCutoff;
+	mBeta[ slot ] = beta;
+
+	for ( size_t lane = slot; lane < mCount; lane += sBlockSize )
+	{
+		mLaneMinCutoff[ lane ] = minCutoff;
+		mLaneBeta[ lane ] = beta;
+	}
+}
+
+void JointFilter::reset()
+{
+	mHasTime = false;
+	std::fill( mBlockUsed.begin(), mBlockUsed.end(), false );
+	std::fill( mStarted.begin(), mStarted.end(), 0.f );
+}
+
+void JointFilter::resize( size_t blockCount )
+{
+	size_t count = blockCount * sBlockSize;
+
+	mBlockUsers.resize( blockCount, 0 );
+	mBlockUsed.resize( blockCount, false );
+	mBlockSeen.resize( blockCount, false );
+
+	mX.resize( count, 0.f );
+	mY.resize( count, 0.f );
+	mDx.resize( count, 0.f );
+	mDy.resize( count, 0.f );
+	mRawX.resize( count, 0.f );
+	mRawY.resize( count, 0.f );
+	mStarted.resize( count, 0.f );
+	mInX.resize( count, 0.f );
+	mInY.resize( count, 0.f );
+	mInput.resize( count, 0.f );
+
+	// the lanes past the table are never used
+	mLaneMinCutoff.resize( count, 1.f );
+	mLaneBeta.resize( count, 0.f );
+	for ( size_t lane = mCount; lane < count; lane++ )
+	{
+		size_t slot = lane % sBlockSize;
+		if ( slot < size_t( JointTable::sCount ) )
+		{
+			mLaneMinCutoff[ lane ] = mMinCutoff[ slot ];
+			mLaneBeta[ lane ] = mBeta[ slot ];
+		}
+	}
+
+	mCount = count;
+}
+
+size_t JointFilter::getBlock( unsigned userId )
+{
+	size_t blockCount = mBlockUsers.size();
+	size_t freeBlock = blockCount;
+	for ( size_t i = 0; i < blockCount; i++ )
+	{
+		if ( mBlockUsed[ i ] && ( mBlockUsers[ i ] == userId ) )
+		{
+			mBlockSeen[ i ] = true;
+			return i;
+		}
+		if ( ! mBlockUsed[ i ] && ( freeBlock == blockCount ) )
+			freeBlock = i;
+	}
+
+	// new user, its lanes start from the first sample
+	if ( freeBlock == blockCount )
+		resize( blockCount + 1 );
+
+	mBlockUsers[ freeBlock ] = userId;
+	mBlockUsed[ freeBlock ] = true;
+	mBlockSeen[ freeBlock ] = true;
+	std::fill( mStarted.begin() + freeBlock * sBlockSize, mStarted.begin() + ( freeBlock + 1 ) * sBlockSize, 0.f );
+	return freeBlock;
+}
+
+const vector< Vec2f > &JointFilter::apply( const JointFrame &frame )
+{
+	double dt = frame.time - mTime;
+	if ( ! mHasTime || ( dt <= 0.0 ) || ( dt > sMaxGap ) )
+	{
+		std::fill( mStarted.begin(), mStarted.end(), 0.f );
+		dt = 1.0 / 30.0;
+	}
+	mHasTime = true;
+	mTime = frame.time;
+
+	std::fill( mBlockSeen.begin(), mBlockSeen.end(), false );
+	std::fill( mInput.begin(), mInput.end(), 0.f );
+
+	mOutput.resize( frame.joints.size() );
+	mLanes.resize( frame.joints.size() );
+
+	size_t block = 0;
+	for ( size_t i = 0; i < frame.joints.size(); i++ )
+	{
+		const JointFrame::Joint &joint = frame.joints[ i ];
+
+		// joints of a user are consecutive
+		if ( ( i == 0 ) || ( joint.userId != frame.joints[ i - 1 ].userId ) )
+			block = getBlock( joint.userId );
+
+		mOutput[ i ] = joint.pos;
+		mLanes[ i ] = -1;
+
+		int slot = JointTable::getSlot( XnSkeletonJoint( joint.jointId ) );
+		if ( ( slot < 0 ) || ! ( joint.confidence > sMinConfidence ) )
+			continue;
+
+		size_t lane = block * sBlockSize + slot;
+		mInX[ lane ] = joint.pos.x;
+		mInY[ lane ] = joint.pos.y;
+		mInput[ lane ] = 1.f;
+		mLanes[ i ] = int( lane );
+	}
+
+	// users missing from the frame give their lanes back
+	for ( size_t i = 0; i < mBlockUsed.size(); i++ )
+	{
+		if ( mBlockUsed[ i ] && ! mBlockSeen[ i ] )
+			mBlockUsed[ i ] = false;
+	}
+
+#if JOINT_FILTER_SSE
+	filterKernel< SseOps >( 0, mCount, float( dt ) );
+#else
+	filterScalar( 0, mCount, float( dt ) );
+#endif
+
+	for ( size_t i = 0; i < frame.joints.size(); i++ )
+	{
+		if ( mLanes[ i ] >= 0 )
+			mOutput[ i ] = Vec2f( mX[ mLanes[ i ] ], mY[ mLanes[ i ] ] );
+	}
+
+	return mOutput;
+}
+
+const vector< Vec2f > &JointFilter::predict( double time, double maxHorizon )
+{
+	float horizon = float( math< double >::clamp( time - mTime, 0.0, maxHorizon ) );
+
+	mPrediction.resize( mOutput.size() );
+	for ( size_t i = 0; i < mOutput.size(); i++ )
+	{
+		int lane = mLanes[ i ];
+		if ( lane >= 0 )
+			mPrediction[ i ] = Vec2f( mX[ lane ] + mDx[ lane ] * horizon, mY[ lane ] + mDy[ lane ] * horizon );
+		else
+			mPrediction[ i ] = mOutput[ i ];
+	}
+
+	return mPrediction;
+}
+
+void JointFilter::filterScalar( size_t beg, size_t end, float dt )
+{
+	float derivateT = 2.f * float( M_PI ) * sDerivateCutoff * dt;
+	float derivateAlpha = derivateT / ( derivateT + 1.f );
+
+	for ( size_t i = beg; i < end; i++ )
+	{
+		if ( mInput[ i ] == 0.f )
+			continue;
+
+		// lanes without a position start at the sample
+		if ( mStarted[ i ] == 0.f )
+		{
+			mX[ i ] = mInX[ i ];
+			mY[ i ] = mInY[ i ];
+			mDx[ i ] = 0.f;
+			mDy[ i ] = 0.f;
+			mRawX[ i ] = mInX[ i ];
+			mRawY[ i ] = mInY[ i ];
+			mStarted[ i ] = 1.f;
+			continue;
+		}
+
+		Vec2f in( mInX[ i ], mInY[ i ] );
+		Vec2f pos( mX[ i ], mY[ i ] );
+		Vec2f vel( mDx[ i ], mDy[ i ] );
+
+		// the velocity of the samples, the filtered position lags behind them
+		vel += derivateAlpha * ( ( in - Vec2f( mRawX[ i ], mRawY[ i ] ) ) / dt - vel );
+
+		float cutoff = mLaneMinCutoff[ i ] + mLaneBeta[ i ] * vel.length();
+		float t = 2.f * float( M_PI ) * cutoff * dt;
+		pos += t / ( t + 1.f ) * ( in - pos );
+
+		mX[ i ] = pos.x;
+		mY[ i ] = pos.y;
+		mDx[ i ] = vel.x;
+		mDy[ i ] = vel.y;
+		mRawX[ i ] = in.x;
+		mRawY[ i ] = in.y;
+	}
+}
+
+template< typename Ops >
+void JointFilter::filterKernel( size_t beg, size_t end, float dt )
+{
+	typedef typename Ops::V V;
+
+	float derivateT = 2.f * float( M_PI ) * sDerivateCutoff * dt;
+
+	const V zero = Ops::set( 0.f );
+	const V one = Ops::set( 1.f );
+	const V invDt = Ops::set( 1.f / dt );
+	const V twoPiDt = Ops::set( 2.f * float( M_PI ) * dt );
+	const V derivateAlpha = Ops::set( derivateT / ( derivateT + 1.f ) );
+
+	for ( size_t i = beg; i < end; i += Ops::sWidth )
+	{
+		V input = Ops::gt( Ops::load( &mInput[ i ] ), zero );
+		V started = Ops::gt( Ops::load( &mStarted[ i ] ), zero );
+
+		V inX = Ops::load( &mInX[ i ] );
+		V inY = Ops::load( &mInY[ i ] );
+		V posX = Ops::load( &mX[ i ] );
+		V posY = Ops::load( &mY[ i ] );
+		V velX = Ops::load( &mDx[ i ] );
+		V velY = Ops::load( &mDy[ i ] );
+
+		V rawX = Ops::load( &mRawX[ i ] );
+		V rawY = Ops::load( &mRawY[ i ] );
+
+		// the velocity of the samples, the filtered position lags behind them
+		V stepX = Ops::mul( Ops::sub( inX, rawX ), invDt );
+		V stepY = Ops::mul( Ops::sub( inY, rawY ), invDt );
+		velX = Ops::add( velX, Ops::mul( derivateAlpha, Ops::sub( stepX, velX ) ) );
+		velY = Ops::add( velY, Ops::mul( derivateAlpha, Ops::sub( stepY, velY ) ) );
+		V dX = Ops::sub( inX, posX );
+		V dY = Ops::sub( inY, posY );
+
+		V speed = Ops::sqrt( Ops::add( Ops::mul( velX, velX ), Ops::mul( velY, velY ) ) );
+		V cutoff = Ops::add( Ops::load( &mLaneMinCutoff[ i ] ), Ops::mul( Ops::load( &mLaneBeta[ i ] ), speed ) );
+		V t = Ops::mul( twoPiDt, cutoff );
+		V alpha = Ops::div( t, Ops::add( t, one ) );
+
+		// lanes without a position start at the sample
+		V newX = Ops::select( started, Ops::add( posX, Ops::mul( alpha, dX ) ), inX );
+		V newY = Ops::select( started, Ops::add( posY, Ops::mul( alpha, dY ) ), inY );
+		velX = Ops::and_( started, velX );
+		velY = Ops::and_( started, velY );
+
+		// lanes without a sample keep their state
+		Ops::store( &mX[ i ], Ops::select( input, newX, posX ) );
+		Ops::store( &mY[ i ], Ops::select( input, newY, posY ) );
+		Ops::store( &mDx[ i ], Ops::select( input, velX, Ops::load( &mDx[ i ] ) ) );
+		Ops::store( &mDy[ i ], Ops::select( input, velY, Ops::load( &mDy[ i ] ) ) );
+		Ops::store( &mRawX[ i ], Ops::select( input, inX, rawX ) );
+		Ops::store( &mRawY[ i ], Ops::select( input, inY, rawY ) );
+		Ops::store( &mStarted[ i ], Ops::and_( Ops::or_( input, started ), one ) );
+	}
+}
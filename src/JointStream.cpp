@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cstring>
+
+#include "JointStream.h"
+
+using namespace std;
+using namespace ci;
+
+namespace {
+
+const char    sMagic[ 4 ]  = { 'P', 'R', 'J', 'S' };
+const uint8_t sVersion     = 1;
+const size_t  sJointBytes  = 2 + 1 + 3 * sizeof( float );
+
+template< typename T >
+void put( uint8_t *&out, T value )
+{
+	memcpy( out, &value, sizeof( T ) );
+	out += sizeof( T );
+}
+
+template< typename T >
+T get( const uint8_t *&in )
+{
+	T value;
+	memcpy( &value, in, sizeof( T ) );
+	in += sizeof( T );
+	return value;
+}
+
+} // anonymous namespace
+
+const size_t JointStreamWriter::sQueueCapacity = 1 << 20;
+
+JointStreamWriter::JointStreamWriter()
+: mOpen( false )
+, mStarted( false )
+, mStartTime( 0.0 )
+, mDropped( 0 )
+{
+}
+
+JointStreamWriter::~JointStreamWriter()
+{
+	close();
+}
+
+void JointStreamWriter::open( const fs::path &path )
+{
+	close();
+
+	mFile.open( path.string().c_str(), ios::out | ios::binary | ios::trunc );
+	if ( ! mFile )
+		throw JointStreamExc( "unable to write joint stream " + path.string() );
+
+	mFile.write( sMagic, sizeof( sMagic ) );
+	mFile.put( char( sVersion ) );
+	mBuffer.reserve( sQueueCapacity );
+
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		mPending.clear();
+		mPending.reserve( sQueueCapacity );
+		mStarted = false;
+		mDropped = 0;
+		mOpen = true;
+	}
+
+	mThread = thread( bind( &JointStreamWriter::writeThread, this ) );
+}
+
+void JointStreamWriter::close()
+{
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		if ( ! mOpen )
+			return;
+		mOpen = false;
+	}
+	mCond.notify_all();
+	mThread.join();
+}
+
+bool JointStreamWriter::isOpen() const
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	return mOpen;
+}
+
+void JointStreamWriter::write( const JointFrame &frame )
+{
+	uint16_t count = uint16_t( std::min< size_t >( frame.joints.size(), 0xffff ) );
+	size_t bytes = sizeof( double ) + sizeof( uint16_t ) + count * sJointBytes;
+
+	bool wake;
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		if ( ! mOpen )
+			return;
+
+		if ( ! mStarted )
+		{
+			mStartTime = frame.time;
+			mStarted = true;
+		}
+
+		// memory stays bounded, whole frames are dropped if the writer falls behind
+		if ( mPending.size() + bytes > sQueueCapacity )
+		{
+			mDropped++;
+			return;
+		}
+
+		// encoded in place, the pending buffer is reserved when opened
+		wake = mPending.empty();
+		size_t size = mPending.size();
+		mPending.resize( size + bytes );
+		uint8_t *out = &mPending[ size ];
+		put< double >( out, frame.time - mStartTime );
+		put< uint16_t >( out, count );
+		for ( uint16_t i = 0; i < count; i++ )
+		{
+			const JointFrame::Joint &joint = frame.joints[ i ];
+			put< uint16_t >( out, uint16_t( joint.userId ) );
+			put< uint8_t >( out, uint8_t( joint.jointId ) );
+			put< float >( out, joint.pos.x );
+			put< float >( out, joint.pos.y );
+			put< float >( out, joint.confidence );
+		}
+	}
+
+	if ( wake )
+		mCond.notify_all();
+}
+
+size_t JointStreamWriter::getDropped() const
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	return mDropped;
+}
+
+void JointStreamWriter::writeThread()
+{
+	bool open = true;
+	while ( open )
+	{
+		{
+			std::unique_lock< std::mutex > lock( mMutex );
+			while ( mOpen && mPending.empty() )
+				mCond.wait( lock );
+			mBuffer.swap( mPending );
+			open = mOpen;
+		}
+
+		if ( ! mBuffer.empty() )
+			mFile.write( reinterpret_cast< const char * >( &mBuffer[ 0 ] ), mBuffer.size() );
+		mBuffer.clear();
+	}
+
+	mFile.close();
+}
+
+JointStreamReader::JointStreamReader( const fs::path &path )
+{
+	mFile.open( path.string().c_str(), ios::in | ios::binary );
+
+	char magic[ 4 ];
+	if ( ! mFile.read( magic, sizeof( magic ) ) || memcmp( magic, sMagic, sizeof( magic ) ) != 0 ||
+		 ( mFile.get() != sVersion ) )
+		throw JointStreamExc( "not a joint stream " + path.string() );
+}
+
+bool JointStreamReader::read( JointFrame *frame )
+{
+	uint8_t header[ sizeof( double ) + sizeof( uint16_t ) ];
+	if ( ! mFile.read( reinterpret_cast< char * >( header ), sizeof( header ) ) )
+		return false;
+
+	const uint8_t *in = header;
+	frame->time = get< double >( in );
+	uint16_t count = get< uint16_t >( in );
+
+	frame->joints.resize( count );
+	if ( count == 0 )
+		return true;
+
+	mBuffer.resize( count * sJointBytes );
+	if ( ! mFile.read( reinterpret_cast< char * >( &mBuffer[ 0 ] ), mBuffer.size() ) )
+		return false;
+
+	in = &mBuffer[ 0 ];
+	for ( uint16_t i = 0; i < count; i++ )
+	{
+		JointFrame::Joint &joint = frame->joints[ i ];
+		joint.userId     = get< uint16_t >( in );
+		joint.jointId    = get< uint8_t >( in );
+		joint.pos.x      = get< float >( in );
+		joint.pos.y      = get< float >( in );
+		joint.confidence = get< float >( in );
+	}
+
+	return true;
+}
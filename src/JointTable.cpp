@@ -0,0 +1,77 @@
+#include "JointTable.h"
+
+// the hands follow fast moves, the torso is held steady
+const JointTable::Joint JointTable::sJoints[ JointTable::sCount ] =
+{
+	{ XN_SKEL_LEFT_HAND     , "Left hand"     , true ,  0, 1.5f, .02f  },
+	{ XN_SKEL_LEFT_SHOULDER , "Left shoulder" , true ,  1, .5f , .005f },
+	{ XN_SKEL_HEAD          , "Head"          , true ,  2, .8f , .005f },
+	{ XN_SKEL_RIGHT_HAND    , "Right hand"    , true ,  3, 1.5f, .02f  },
+	{ XN_SKEL_RIGHT_SHOULDER, "Right shoulder", true ,  4, .5f , .005f },
+	{ XN_SKEL_TORSO         , "Torso"         , true ,  5, .3f , .002f },
+	{ XN_SKEL_LEFT_KNEE     , "Left knee"     , true ,  6, .8f , .01f  },
+	{ XN_SKEL_RIGHT_KNEE    , "Right knee"    , true ,  7, .8f , .01f  },
+	{ XN_SKEL_LEFT_FOOT     , "Left foot"     , true ,  8, 1.f , .01f  },
+	{ XN_SKEL_RIGHT_FOOT    , "Right foot"    , true ,  9, 1.f , .01f  },
+	{ XN_SKEL_NECK          , "Neck"          , false, -1, .5f , .005f }, // only for the body lines
+	{ XN_SKEL_LEFT_HIP      , "Left hip"      , false, -1, .3f , .002f },
+	{ XN_SKEL_RIGHT_HIP     , "Right hip"     , false, -1, .3f , .002f }
+};
+
+namespace {
+
+enum Slots
+{
+	LEFT_HAND = 0, LEFT_SHOULDER, HEAD, RIGHT_HAND, RIGHT_SHOULDER, TORSO,
+	LEFT_KNEE, RIGHT_KNEE, LEFT_FOOT, RIGHT_FOOT, NECK, LEFT_HIP, RIGHT_HIP
+};
+
+} // anonymous namespace
+
+const JointTable::Bone JointTable::sBones[ JointTable::sBoneCount ] =
+{
+	{ LEFT_HAND     , LEFT_SHOULDER  },
+	{ LEFT_SHOULDER , NECK           },
+	{ RIGHT_SHOULDER, NECK           },
+	{ RIGHT_HAND    , RIGHT_SHOULDER },
+	{ HEAD          , NECK           },
+	{ LEFT_SHOULDER , TORSO          },
+	{ RIGHT_SHOULDER, TORSO          },
+	{ TORSO         , LEFT_HIP       },
+	{ TORSO         , RIGHT_HIP      },
+	{ LEFT_HIP      , RIGHT_HIP      },
+	{ LEFT_HIP      , LEFT_KNEE      },
+	{ RIGHT_HIP     , RIGHT_KNEE     },
+	{ LEFT_KNEE     , LEFT_FOOT      },
+	{ RIGHT_KNEE    , RIGHT_FOOT     }
+};
+
+// indexed by XnSkeletonJoint
+const int JointTable::sSlots[ JointTable::sIdCount ] =
+{
+	-1,
+	HEAD,           // XN_SKEL_HEAD
+	NECK,           // XN_SKEL_NECK
+	TORSO,          // XN_SKEL_TORSO
+	-1,             // XN_SKEL_WAIST
+	-1,             // XN_SKEL_LEFT_COLLAR
+	LEFT_SHOULDER,  // XN_SKEL_LEFT_SHOULDER
+	-1,             // XN_SKEL_LEFT_ELBOW
+	-1,             // XN_SKEL_LEFT_WRIST
+	LEFT_HAND,      // XN_SKEL_LEFT_HAND
+	-1,             // XN_SKEL_LEFT_FINGERTIP
+	-1,             // XN_SKEL_RIGHT_COLLAR
+	RIGHT_SHOULDER, // XN_SKEL_RIGHT_SHOULDER
+	-1,             // XN_SKEL_RIGHT_ELBOW
+	-1,             // XN_SKEL_RIGHT_WRIST
+	RIGHT_HAND,     // XN_SKEL_RIGHT_HAND
+	-1,             // XN_SKEL_RIGHT_FINGERTIP
+	LEFT_HIP,       // XN_SKEL_LEFT_HIP
+	LEFT_KNEE,      // XN_SKEL_LEFT_KNEE
+	-1,             // XN_SKEL_LEFT_ANKLE
+	LEFT_FOOT,      // XN_SKEL_LEFT_FOOT
+	RIGHT_HIP,      // XN_SKEL_RIGHT_HIP
+	RIGHT_KNEE,     // XN_SKEL_RIGHT_KNEE
+	-1,             // XN_SKEL_RIGHT_ANKLE
+	RIGHT_FOOT      // XN_SKEL_RIGHT_FOOT
+};
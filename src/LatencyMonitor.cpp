@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <string>
+
+#include "cinder/app/App.h"
+#include "cinder/Vector.h"
+
+#include "LatencyMonitor.h"
+
+using namespace std;
+using namespace ci;
+using namespace ci::app;
+
+const double LatencyMonitor::sBucketSize = .005;
+const double LatencyMonitor::sInterval = 5.0;
+const char  *LatencyMonitor::sStageNames[ LatencyMonitor::STAGE_COUNT ] = { "Apply", "Emit", "Draw", "Swap" };
+
+LatencyMonitor::Histogram::Histogram()
+{
+	clear();
+}
+
+void LatencyMonitor::Histogram::clear()
+{
+	std::fill( buckets, buckets + sBucketCount, 0 );
+	count = 0;
+	sum = 0.0;
+	max = 0.0;
+}
+
+void LatencyMonitor::Histogram::add( double latency )
+{
+	int bucket = std::min( int( latency / sBucketSize ), sBucketCount - 1 );
+	buckets[ std::max( bucket, 0 ) ]++;
+	count++;
+	sum += latency;
+	max = std::max( max, latency );
+}
+
+double LatencyMonitor::Histogram::getQuantile( double fraction ) const
+{
+	int rank = int( fraction * count );
+	int n = 0;
+	for ( int i = 0; i < sBucketCount - 1; i++ )
+	{
+		n += buckets[ i ];
+		if ( n > rank )
+			return ( i + 1 ) * sBucketSize;
+	}
+	return max;
+}
+
+LatencyMonitor::LatencyMonitor()
+: mIntervalStart( -1.0 )
+, mLogEnabled( false )
+{
+	for ( int i = 0; i < STAGE_COUNT; i++ )
+	{
+		mLastJointTime[ i ] = -1.0;
+		mMean[ i ] = mMedian[ i ] = mPercentile95[ i ] = mMax[ i ] = 0.f;
+	}
+}
+
+void LatencyMonitor::setup( const fs::path &logPath )
+{
+	mLogPath = logPath;
+
+	mParams = mndl::params::PInterfaceGl( "Latency", Vec2i( 200, 300 ), Vec2i( 16, 336 ) );
+	mParams.addPersistentSizeAndPosition();
+	mParams.addText( "Sensor to stage, ms" );
+	for ( int i = 0; i < STAGE_COUNT; i++ )
+	{
+		string name = sStageNames[ i ];
+		string group = "group='" + name + "'";
+		mParams.addParam( name + " mean", &mMean[ i ], group, true );
+		mParams.addParam( name + " median", &mMedian[ i ], group, true );
+		mParams.addParam( name + " 95%", &mPercentile95[ i ], group, true );
+		mParams.addParam( name + " max", &mMax[ i ], group, true );
+	}
+	mParams.addSeparator();
+	mParams.addPersistentParam( "Write log", &mLogEnabled, false );
+	mParams.setOptions( "", "refresh=1" );
+}
+
+void LatencyMonitor::add( Stage stage, double jointTime, double time )
+{
+	// frames already counted at this stage
+	if ( ( jointTime < 0.0 ) || ( jointTime <= mLastJointTime[ stage ] ) )
+		return;
+
+	mLastJointTime[ stage ] = jointTime;
+	mHistograms[ stage ].add( time - jointTime );
+}
+
+void LatencyMonitor::update( double time )
+{
+	if ( mIntervalStart < 0.0 )
+		mIntervalStart = time;
+	if ( time - mIntervalStart < sInterval )
+		return;
+
+	for ( int i = 0; i < STAGE_COUNT; i++ )
+	{
+		const Histogram &histogram = mHistograms[ i ];
+		mMean[ i ] = histogram.count ? float( 1000.0 * histogram.sum / histogram.count ) : 0.f;
+		mMedian[ i ] = histogram.count ? float( 1000.0 * histogram.getQuantile( .5 ) ) : 0.f;
+		mPercentile95[ i ] = histogram.count ? float( 1000.0 * histogram.getQuantile( .95 ) ) : 0.f;
+		mMax[ i ] = float( 1000.0 * histogram.max );
+	}
+
+	if ( mLogEnabled )
+		writeLog( time );
+	else if ( mLog.is_open() )
+		mLog.close();
+
+	for ( int i = 0; i < STAGE_COUNT; i++ )
+		mHistograms[ i ].clear();
+	mIntervalStart = time;
+}
+
+void LatencyMonitor::writeLog( double time )
+{
+	if ( ! mLog.is_open() )
+	{
+		mLog.open( mLogPath.string().c_str(), ios::out | ios::app );
+		if ( ! mLog )
+		{
+			console() << "unable to write latency log " << mLogPath << endl;
+			mLogEnabled = false;
+			return;
+		}
+		mLog << "# time stage count mean median p95 max [ms], then the counts of the 5 ms buckets" << endl;
+	}
+
+	for ( int i = 0; i < STAGE_COUNT; i++ )
+	{
+		const Histogram &histogram = mHistograms[ i ];
+		mLog << time << " " << sStageNames[ i ] << " " << histogram.count << " "
+			 << mMean[ i ] << " " << mMedian[ i ] << " " << mPercentile95[ i ] << " " << mMax[ i ];
+		for ( int b = 0; b < Histogram::sBucketCount; b++ )
+			mLog << " " << histogram.buckets[ b ];
+		mLog << endl;
+	}
+}
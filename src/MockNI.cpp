@@ -0,0 +1,180 @@
+#include "NIBackend.h"
+
+#if USE_MOCK_NI
+
+#include <algorithm>
+#include <unordered_map>
+
+#include "JointTable.h"
+
+using namespace std;
+using namespace ci;
+
+namespace mndl { namespace ni {
+
+//! Shared state of an OpenNI instance and its user trackers.
+class MockDevice
+{
+	public:
+		MockDevice( SkeletonSourceRef source ) : mSource( source ), mStarted( false ), mMirrored( false ) {}
+
+		//! Indexes the joints of mFrame by user and joint slot.
+		void indexFrame();
+		//! Returns the joint of \a userId with \a jointId in mFrame, NULL if it is not in the frame.
+		const JointFrame::Joint *findJoint( XnUserID userId, XnSkeletonJoint jointId ) const;
+
+		SkeletonSourceRef                      mSource;
+		bool                                   mStarted;
+		bool                                   mMirrored;
+		std::vector< UserTracker::Listener * > mListeners;
+		JointFrame                             mFrame;
+		std::vector< SkeletonSource::Event >   mEvents;
+
+		// the joints are looked up once per user and joint, a scan of the frame would distort the timing of the tracking code
+		std::unordered_map< XnUserID, size_t > mUserJoints;  // first element of the user in mJointIndices
+		std::vector< int >                     mJointIndices; // JointTable::sCount for each user, the index in mFrame or -1
+};
+
+void MockDevice::indexFrame()
+{
+	mUserJoints.clear();
+	mJointIndices.clear();
+	for ( size_t i = 0; i < mFrame.joints.size(); i++ )
+	{
+		const JointFrame::Joint &joint = mFrame.joints[ i ];
+		int slot = JointTable::getSlot( XnSkeletonJoint( joint.jointId ) );
+		if ( slot < 0 )
+			continue;
+
+		std::unordered_map< XnUserID, size_t >::const_iterator user = mUserJoints.find( joint.userId );
+		size_t first;
+		if ( user == mUserJoints.end() )
+		{
+			first = mJointIndices.size();
+			mUserJoints[ joint.userId ] = first;
+			mJointIndices.resize( first + JointTable::sCount, -1 );
+		}
+		else
+		{
+			first = user->second;
+		}
+		mJointIndices[ first + slot ] = int( i );
+	}
+}
+
+const JointFrame::Joint *MockDevice::findJoint( XnUserID userId, XnSkeletonJoint jointId ) const
+{
+	int slot = JointTable::getSlot( jointId );
+	std::unordered_map< XnUserID, size_t >::const_iterator user = mUserJoints.find( userId );
+	if ( ( slot < 0 ) || ( user == mUserJoints.end() ) )
+		return NULL;
+
+	int index = mJointIndices[ user->second + slot ];
+	return ( index >= 0 ) ? &mFrame.joints[ index ] : NULL;
+}
+
+SyntheticSource::Options OpenNI::sDeviceOptions;
+
+void UserTracker::addListener( Listener *listener )
+{
+	if ( mDevice )
+		mDevice->mListeners.push_back( listener );
+}
+
+Vec2f UserTracker::getJoint2d( XnUserID userId, XnSkeletonJoint jointId, float *conf /* = NULL */ )
+{
+	const JointFrame::Joint *joint = mDevice ? mDevice->findJoint( userId, jointId ) : NULL;
+	if ( joint )
+	{
+		if ( conf )
+			*conf = joint->confidence;
+		return joint->pos;
+	}
+
+	if ( conf )
+		*conf = 0.f;
+	return Vec2f::zero();
+}
+
+OpenNI::OpenNI( Device device )
+{
+	SyntheticSource::Options options = sDeviceOptions;
+	options.seed += device.index;
+	mDevice = std::shared_ptr< MockDevice >( new MockDevice( SkeletonSourceRef( new SyntheticSource( options ) ) ) );
+	mDevice->mSource->open();
+}
+
+OpenNI::OpenNI( const fs::path &recording )
+{
+	SkeletonSourceRef source( new JointStreamSource( recording ) );
+	if ( ! source->open() )
+		throw JointStreamExc( source->getStatus() + " " + recording.string() );
+
+	mDevice = std::shared_ptr< MockDevice >( new MockDevice( source ) );
+}
+
+void OpenNI::setDeviceOptions( const SyntheticSource::Options &options )
+{
+	sDeviceOptions = options;
+}
+
+void OpenNI::start()
+{
+	if ( mDevice )
+		mDevice->mStarted = true;
+}
+
+bool OpenNI::isMirrored() const
+{
+	return mDevice && mDevice->mMirrored;
+}
+
+void OpenNI::setMirrored( bool mirrored /* = true */ )
+{
+	if ( mDevice )
+		mDevice->mMirrored = mirrored;
+}
+
+bool OpenNI::checkNewDepthFrame()
+{
+	if ( ! mDevice || ! mDevice->mStarted )
+		return false;
+
+	bool newFrame = mDevice->mSource->read( &mDevice->mFrame, &mDevice->mEvents );
+
+	// OpenNI tracks the skeleton of a new user after its calibration
+	for ( vector< SkeletonSource::Event >::const_iterator it = mDevice->mEvents.begin(); it != mDevice->mEvents.end(); ++it )
+	{
+		UserTracker::UserEvent event;
+		event.id = it->second;
+		for ( vector< UserTracker::Listener * >::const_iterator lt = mDevice->mListeners.begin(); lt != mDevice->mListeners.end(); ++lt )
+		{
+			if ( it->first == SkeletonSource::USER_NEW )
+			{
+				( *lt )->newUser( event );
+				( *lt )->calibrationBeg( event );
+				( *lt )->calibrationEnd( event );
+			}
+			else
+			{
+				( *lt )->lostUser( event );
+			}
+		}
+	}
+	mDevice->mEvents.clear();
+
+	if ( newFrame && mDevice->mMirrored )
+	{
+		vector< JointFrame::Joint > &joints = mDevice->mFrame.joints;
+		for ( vector< JointFrame::Joint >::iterator it = joints.begin(); it != joints.end(); ++it )
+			it->pos.x = 640.f - it->pos.x;
+	}
+	if ( newFrame )
+		mDevice->indexFrame();
+
+	return newFrame;
+}
+
+} } // namespace mndl::ni
+
+#endif // USE_MOCK_NI
@@ -1,15 +1,16 @@
+#include <algorithm>
+
 #include <boost/foreach.hpp>
-#include <boost/assign/std/vector.hpp>
 
 #include "cinder/app/App.h"
 #include "cinder/ip/grayscale.h"
+#include "cinder/Utilities.h"
 #include "AntTweakBar.h"
 #include "NIUser.h"
 #include "Utils.h"
 using namespace std;
 using namespace ci;
 using namespace ci::app;
-using namespace mndl::ni;
 
 namespace cinder
 {
@@ -31,12 +32,15 @@ o--o--o---o--o--o
 
 User::User( UserManager *userManager )
 : mUserManager( userManager )
+, mStrokeTransformValid( false )
+, mStrokeTransformVersion( 0 )
 {
+	clearPoints();
 }
 
 void User::clearPoints()
 {
-	mJointPositions.clear();
+	std::fill( mJointConfidences, mJointConfidences + JointTable::sCount, 0.f );
 }
 
 void User::update()
@@ -44,15 +48,43 @@ void User::update()
 	mStrokeManager.update();
 }
 
-void User::addPos( XnSkeletonJoint jointId, Vec2f pos )
+void User::buildStrokes( float alpha, StrokeBatch &batch )
 {
-	mJointPositions.insert( pair< XnSkeletonJoint, Vec2f >( jointId, pos ));
+	batch.setTransform( mStrokeTransform );
+	mStrokeManager.buildGeometry( alpha, batch );
+}
+
+void User::updateTransform( const Calibrate &calibrate )
+{
+	Vec2f strokePos = mPosRef / mUserManager->mOutputRect.getSize();
+	if( mStrokeTransformValid
+	 && mStrokeTransformVersion == calibrate.getVersion()
+	 && mStrokeTransformPos == strokePos )
+		return;
+
+	mStrokeTransform = calibrate.getMatrix( strokePos );
+	mStrokeTransformValid = true;
+	mStrokeTransformVersion = calibrate.getVersion();
+	mStrokeTransformPos = strokePos;
+}
 
-	Vec2f strokePos = pos / mUserManager->mOutputRect.getSize();
+void User::addPos( XnSkeletonJoint jointId, Vec2f pos, float confidence, double time )
+{
+	int slot = JointTable::getSlot( jointId );
+	if( slot < 0 )
+		return;
 
-	mStrokeManager.setActive( jointId , mUserManager->getStrokeActive( jointId ));
-	mStrokeManager.setBrush ( jointId , mUserManager->getStrokeBrush ( jointId ));
-	mStrokeManager.addPos( jointId , strokePos );
+	mJointPositions  [ slot ] = pos;
+	mJointConfidences[ slot ] = confidence;
+
+	if( JointTable::sJoints[ slot ].visible )
+	{
+		Vec2f strokePos = pos / mUserManager->mOutputRect.getSize();
+
+		mStrokeManager.setActive( jointId , mUserManager->getStrokeActive( slot ));
+		mStrokeManager.setBrush ( jointId , mUserManager->getStrokeBrush ( slot ));
+		mStrokeManager.addPos( jointId , strokePos, time );
+	}
 
 	if( jointId == mUserManager->mJointRef )
 		mPosRef = pos;
@@ -63,131 +95,224 @@ void User::addStroke( XnSkeletonJoint jointId )
 	mStrokeManager.createStroke( jointId );
 }
 
-void User::clearStrokes()
+void User::reserveStroke( XnSkeletonJoint jointId )
 {
-	mStrokeManager.clear();
+	mStrokeManager.reserve( jointId );
 }
 
-void User::drawStroke( const Calibrate &calibrate )
+void User::reset()
 {
-	Vec2f strokePos = mPosRef / mUserManager->mOutputRect.getSize();
-	mStrokeManager.draw( calibrate, strokePos );
+	clearPoints();
+	mPosRef = Vec2f::zero();
+	mStrokeTransform.setToIdentity();
+	mStrokeTransformValid = false;
+
+	mStrokeManager.destroyStrokes();
+	mStrokeManager.setRecorder( NULL, 0 );
+}
+
+void User::setRecorder( StrokeRecorder *recorder, unsigned userId )
+{
+	mStrokeManager.setRecorder( recorder, userId );
+}
+
+void User::clearStrokes()
+{
+	mStrokeManager.clear();
 }
 
 void User::drawBody( const Calibrate &calibrate )
 {
+	if( ! mUserManager->mJointShow
+	 && ! mUserManager->mLineShow )
+		return;
+
+	Matrix44f transform = getRectMappingMatrix( mUserManager->mOutputRect, Rectf( mUserManager->mSourceBounds ))
+						* calibrate.getMatrix( mPosRef );
+
 	if( mUserManager->mJointShow )
-		drawJoints( calibrate );
+		drawJoints( transform );
 	if( mUserManager->mLineShow )
-		drawLines( calibrate );
+		drawLines( transform );
 }
 
-void User::drawJoints( const Calibrate &calibrate )
+void User::drawJoints( const Matrix44f &transform )
 {
 	gl::color( mUserManager->mJointColor );
 	float sc = mUserManager->mOutputRect.getWidth() / 640.0f;
 	float scaledJointSize = mUserManager->mJointSize * sc;
-	RectMapping mapping( mUserManager->mOutputRect, mUserManager->mSourceBounds );
 
-	for( JointPositions::const_iterator it = mJointPositions.begin(); it != mJointPositions.end(); ++it )
+	for( int i = 0; i < JointTable::sCount; i++ )
 	{
-		XnSkeletonJoint jointId = it->first;
-
-		if( jointId == XN_SKEL_NECK
-		 || jointId == XN_SKEL_LEFT_HIP
-		 || jointId == XN_SKEL_RIGHT_HIP )
+		if( ! JointTable::sJoints[ i ].visible
+		 || mJointConfidences[ i ] <= 0.f )
 			continue;
 
-		Vec2f pos = it->second;
-		gl::drawSolidCircle( mapping.map( calibrate.transform( pos, mPosRef )), scaledJointSize );
+		// only the center is transformed, the circle is not scaled by the calibration
+		Vec2f pos = mJointPositions[ i ];
+		gl::drawSolidCircle( transform.transformPointAffine( Vec3f( pos, 0.f )).xy(), scaledJointSize );
 	}
 	gl::color( ColorA( 1, 1, 1, 1 ));
 }
 
-void User::drawLines( const Calibrate &calibrate )
+void User::drawLines( const Matrix44f &transform )
 {
-	gl::color( mUserManager->mJointColor );
-
-	drawLine( calibrate, XN_SKEL_LEFT_HAND     , XN_SKEL_LEFT_SHOULDER  );
-	drawLine( calibrate, XN_SKEL_LEFT_SHOULDER , XN_SKEL_NECK           );
-	drawLine( calibrate, XN_SKEL_RIGHT_SHOULDER, XN_SKEL_NECK           );
-	drawLine( calibrate, XN_SKEL_RIGHT_HAND    , XN_SKEL_RIGHT_SHOULDER );
-	drawLine( calibrate, XN_SKEL_HEAD          , XN_SKEL_NECK           );
-	drawLine( calibrate, XN_SKEL_LEFT_SHOULDER , XN_SKEL_TORSO          );
-	drawLine( calibrate, XN_SKEL_RIGHT_SHOULDER, XN_SKEL_TORSO          );
-	drawLine( calibrate, XN_SKEL_TORSO         , XN_SKEL_LEFT_HIP       );
-	drawLine( calibrate, XN_SKEL_TORSO         , XN_SKEL_RIGHT_HIP      );
-	drawLine( calibrate, XN_SKEL_LEFT_HIP      , XN_SKEL_RIGHT_HIP      );
-	drawLine( calibrate, XN_SKEL_LEFT_HIP      , XN_SKEL_LEFT_KNEE      );
-	drawLine( calibrate, XN_SKEL_RIGHT_HIP     , XN_SKEL_RIGHT_KNEE     );
-	drawLine( calibrate, XN_SKEL_LEFT_KNEE     , XN_SKEL_LEFT_FOOT      );
-	drawLine( calibrate, XN_SKEL_RIGHT_KNEE    , XN_SKEL_RIGHT_FOOT     );
+	GLsizei vertexCount = 0;
+	for( int i = 0; i < JointTable::sBoneCount; i++ )
+	{
+		const JointTable::Bone &bone = JointTable::sBones[ i ];
+		if( mJointConfidences[ bone.slot0 ] <= 0.f
+		 || mJointConfidences[ bone.slot1 ] <= 0.f )
+			continue;
 
-	gl::color( ColorA( 1, 1, 1, 1 ));
-}
+		mLineVertices[ vertexCount++ ] = mJointPositions[ bone.slot0 ];
+		mLineVertices[ vertexCount++ ] = mJointPositions[ bone.slot1 ];
+	}
 
-void User::drawLine( const Calibrate &calibrate, XnSkeletonJoint jointBeg, XnSkeletonJoint jointEnd )
-{
-	JointPositions::iterator it;
-	it = mJointPositions.find( jointBeg );
-	if( it == mJointPositions.end())
+	if( vertexCount == 0 )
 		return;
 
-	Vec2f posBeg = it->second;
-
-	it = mJointPositions.find( jointEnd );
-	if( it == mJointPositions.end())
-		return;
+	gl::color( mUserManager->mJointColor );
+	gl::pushModelView();
+	gl::multModelView( transform );
 
-	Vec2f posEnd = it->second;
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glVertexPointer( 2, GL_FLOAT, 0, &mLineVertices[ 0 ] );
+	glDrawArrays( GL_LINES, 0, vertexCount );
+	glDisableClientState( GL_VERTEX_ARRAY );
 
-	RectMapping mapping( mUserManager->mOutputRect, mUserManager->mSourceBounds );
-	gl::drawLine( mapping.map( calibrate.transform( posBeg, mPosRef )), mapping.map( calibrate.transform( posEnd, mPosRef )));
+	gl::popModelView();
+	gl::color( ColorA( 1, 1, 1, 1 ));
 }
 
+// users tracked at the same time by OpenNI
+const size_t UserManager::sUserPoolSize = 6;
+// the prediction stops if the sensor frames are late more than this
+const double UserManager::sMaxFrameDelay = .1;
+// a sensor that stopped sending frames does not hold back the others
+const double UserManager::sMaxSensorLag = .2;
+const double UserManager::sRetryDelay = .5;
+const double UserManager::sMaxRetryDelay = 8.0;
+
+const char *UserManager::Sensor::sStateNames[ UserManager::Sensor::STATE_COUNT ] = { "Connecting", "Running", "Lost", "Reconnecting" };
+
 UserManager::UserManager()
 : mJointColor( ColorA::hexA( 0x50ffffff ))
+, mStrokeJob( false )
+, mStrokeBuilt( false )
+, mStrokeQuit( false )
+, mStrokeSteps( 0 )
+, mStrokeAlpha( 1.f )
+, mStrokeStepTime( 0.0 )
+, mStrokeTime( 0.0 )
+, mStrokeFront( 0 )
+, mUserPoolSize( 0 )
+, mReclaimQuit( false )
+, mStatusChanged( false )
+, mSourceType( SkeletonSource::SOURCE_DEVICE )
+, mSourceEnabled( false )
+, mSourceReopen( false )
+, mSensorCount( 1 )
+, mFusionDistance( 60.f )
+, mOpenSourceType( -1 )
+, mStageRect( 0, 0, 640, 480 )
+, mJointTime( -1.0 )
 {
-	mJoints.push_back( XN_SKEL_LEFT_HAND      );
-	mJoints.push_back( XN_SKEL_LEFT_SHOULDER  );
-	mJoints.push_back( XN_SKEL_HEAD           );
-	mJoints.push_back( XN_SKEL_RIGHT_HAND     );
-	mJoints.push_back( XN_SKEL_RIGHT_SHOULDER );
-	mJoints.push_back( XN_SKEL_TORSO          );
-	mJoints.push_back( XN_SKEL_LEFT_KNEE      );
-	mJoints.push_back( XN_SKEL_RIGHT_KNEE     );
-	mJoints.push_back( XN_SKEL_LEFT_FOOT      );
-	mJoints.push_back( XN_SKEL_RIGHT_FOOT     );
-	mJoints.push_back( XN_SKEL_NECK           );  // will not be visible only for body line
-	mJoints.push_back( XN_SKEL_LEFT_HIP       );  // will not be visible only for body line
-	mJoints.push_back( XN_SKEL_RIGHT_HIP      );  // will not be visible only for body line
-
 	mJointRef = XN_SKEL_TORSO;
 }
 
 UserManager::~UserManager()
 {
-	mThread.join();
+	// the sensor threads are joined by the reclaim thread
+	stopTracker();
+
+	{
+		std::lock_guard< std::mutex > lock( mStrokeMutex );
+		mStrokeQuit = true;
+	}
+	mStrokeCond.notify_all();
+	if ( mStrokeThread.joinable() )
+		mStrokeThread.join();
+
+	{
+		std::lock_guard< std::mutex > lock( mReclaimMutex );
+		mReclaimQuit = true;
+	}
+	mReclaimCond.notify_all();
+	if ( mReclaimThread.joinable() )
+		mReclaimThread.join();
 }
 
-void UserManager::setup( const fs::path &path )
+void UserManager::setup()
 {
-	mBrushes = loadTextures( "strokes" );
-	for ( Brushes::iterator it = mBrushes.begin(); it != mBrushes.end(); ++it )
+	setupCommon( true );
+
+	vector< string > sources( SkeletonSource::sTypeNames, SkeletonSource::sTypeNames + SkeletonSource::SOURCE_COUNT );
+	mParams.addPersistentParam( "Source", sources, &mSourceType, SkeletonSource::SOURCE_DEVICE, "group='Source'" );
+	mParams.addPersistentParam( "Recording file", &mRecordingPath, "prothesis-capture.oni", "group='Source'" );
+	mParams.addPersistentParam( "Joint stream file", &mJointStreamPath, "", "group='Source'" );
+	SyntheticSource::Options synthetic;
+	mParams.addPersistentParam( "Synthetic users", &mSyntheticOptions.userCount, synthetic.userCount,
+			"min=1 max=" + toString( sMaxSyntheticUsers ) + " group='Source'" );
+	mParams.addPersistentParam( "Synthetic churn", &mSyntheticOptions.churn, synthetic.churn,
+			"min=0 max=" + toString( sMaxSyntheticChurn ) + " step=.05 group='Source' help='Synthetic users leaving per second, each is replaced by a new one'" );
+	mParams.addPersistentParam( "Synthetic seed", &mSyntheticOptions.seed, synthetic.seed, "min=0 group='Source'" );
+
+	// the sensors are side by side by default, overlapping by 80 pixels
+	mParams.addPersistentParam( "Sensors", &mSensorCount, 1, "min=1 max=" + toString( sMaxSensors ) + " group='Source'" );
+	mParams.addButton( "Open source", std::bind( &UserManager::reopenSource, this ),
+			"group='Source' help='Opens the source, the files, the synthetic users and the sensors set above'" );
+	mParams.addPersistentParam( "Fusion distance", &mFusionDistance, 60.f,
+			"min=0 max=300 step=1 group='Source' help='Largest distance of the torsos of a performer seen by two sensors'" );
+	for ( int i = 0; i < sMaxSensors; i++ )
 	{
-		it->second.bind();
-		it->second.setWrap( GL_REPEAT, GL_REPEAT );
-		it->second.unbind();
+		string name = "Sensor " + toString( i + 1 );
+		string group = " group='" + name + "'";
+		mParams.addPersistentParam( name + " x", &mSensorX[ i ], 560.f * i, "step=1" + group );
+		mParams.addPersistentParam( name + " y", &mSensorY[ i ], 0.f, "step=1" + group );
+		mParams.addPersistentParam( name + " scale", &mSensorScale[ i ], 1.f, "min=.1 max=10 step=.01" + group );
+		mParams.addPersistentParam( name + " rotation", &mSensorRotation[ i ], 0.f, "min=-180 max=180 step=.5" + group );
+		mParams.setOptions( name, "group='Source' opened=false" );
 	}
 
-	mThread = thread( bind( &UserManager::openKinect, this, path ) );
+	mSourceEnabled = true;
+}
+
+void UserManager::setSource( SkeletonSource::Type type, const fs::path &path /* = "" */ )
+{
+	mSourceType = type;
+	mSourceReopen = true;
+	if ( path.empty() )
+		return;
+
+	if ( type == SkeletonSource::SOURCE_RECORDING )
+		mRecordingPath = path.string();
+	else if ( type == SkeletonSource::SOURCE_JOINT_STREAM )
+		mJointStreamPath = path.string();
+}
+
+void UserManager::setupReplay( bool gl /* = true */ )
+{
+	setupCommon( gl );
+
+	mKinectProgress = "Replay";
+}
+
+void UserManager::setupCommon( bool gl )
+{
+	mBrushes.load( "strokes", gl );
+
+	mStrokeThread = thread( bind( &UserManager::strokeThread, this ) );
+	mReclaimThread = thread( bind( &UserManager::reclaimThread, this ) );
+
+	// users are taken from the pool, so users coming and going do not allocate on the frame
+	reserveUsers( sUserPoolSize );
 
 	mParams = mndl::params::PInterfaceGl( "Kinect", Vec2i( 250, 500 ), Vec2i( 224, 16 ) );
 	mParams.addPersistentSizeAndPosition();
 	mParams.addText("Tracking");
 	mKinectProgress = "Connecting...\0\0\0\0\0\0\0\0\0";
-	mParams.addParam( "Kinect", &mKinectProgress, "", true );
-	mParams.addPersistentParam( "Skeleton smoothing" , &mSkeletonSmoothing, 0.9, "min=0 max=1 step=.05");
+	mParams.addParam( "Status", &mKinectProgress, "", true );
 	mParams.addPersistentParam( "Joint show"         , &mJointShow, true  );
 	mParams.addPersistentParam( "Line show"          , &mLineShow , true  );
 	mParams.addPersistentParam( "Mirror"             , &mVideoMirrored, false );
@@ -199,25 +324,37 @@ void UserManager::setup( const fs::path &path )
 
 	vector< string > strokes;
 	strokes.push_back( "No Stroke" );
-	for( Brushes::iterator it = mBrushes.begin(); it != mBrushes.end(); ++it )
-		strokes.push_back( it->first );
-	int strokePos  = 1;
-	int strokeSize = mBrushes.size();
-
-	using namespace boost::assign;
-	vector< string > jointNames;
-	jointNames += "Left hand", "Left shoulder", "Head", "Right hand", "Right shoulder",
-		"Torso", "Left knee", "Right knee", "Left foot", "Right foot";
+	strokes.insert( strokes.end(), mBrushes.getNames().begin(), mBrushes.getNames().end() );
+	int strokeSize = mBrushes.getCount();
+
 	std::vector< std::pair< std::string, boost::any > > vars;
-	for( size_t i = 0; i < jointNames.size(); i++ )
+	for( int i = 0; i < JointTable::sStrokeCount; i++ )
 	{
-		mParams.addPersistentParam( jointNames[ i ] + " active", &mStrokeActive[ i ], true );
-		mParams.addPersistentParam( jointNames[ i ], strokes, &mStrokeSelect[ i ],
-				strokePos <= strokeSize ? strokePos : 0 ); ++strokePos;
-		vars.push_back( make_pair( jointNames[ i ] + " active", &mStrokeActive[ i ] ) );
-		vars.push_back( make_pair( jointNames[ i ], &mStrokeSelect[ i ] ) );
+		string jointName = JointTable::sJoints[ i ].name;
+		int    strokePos = JointTable::sJoints[ i ].defaultBrush + 1;
+		mParams.addPersistentParam( jointName + " active", &mStrokeActive[ i ], true );
+		mParams.addPersistentParam( jointName, strokes, &mStrokeSelect[ i ],
+				strokePos <= strokeSize ? strokePos : 0 );
+		vars.push_back( make_pair( jointName + " active", &mStrokeActive[ i ] ) );
+		vars.push_back( make_pair( jointName, &mStrokeSelect[ i ] ) );
 	}
-	vars.push_back( make_pair( "Skeleton smoothing", &mSkeletonSmoothing ) );
+	mParams.addSeparator();
+
+	// replaces the OpenNI skeleton smoothing, low cutoffs are steady, high betas follow fast moves
+	mParams.addPersistentParam( "Filter joints", &mJointFilterEnabled, true );
+	mParams.addPersistentParam( "Prediction", &mPrediction, .05f, "min=0 max=.2 step=.005 help='Look-ahead of the filtered joints in seconds'" );
+	for( int i = 0; i < JointTable::sCount; i++ )
+	{
+		const JointTable::Joint &joint = JointTable::sJoints[ i ];
+		string jointName = joint.name;
+		mParams.addPersistentParam( jointName + " min cutoff", &mFilterMinCutoff[ i ], joint.minCutoff,
+				"min=0.01 max=10 step=.01 group='Joint filter'" );
+		mParams.addPersistentParam( jointName + " beta", &mFilterBeta[ i ], joint.beta,
+				"min=0 max=1 step=.001 group='Joint filter'" );
+		vars.push_back( make_pair( jointName + " min cutoff", &mFilterMinCutoff[ i ] ) );
+		vars.push_back( make_pair( jointName + " beta", &mFilterBeta[ i ] ) );
+	}
+	mParams.setOptions( "Joint filter", "opened=false" );
 	mParams.addSeparator();
 	mParams.addPresets( vars );
 
@@ -228,111 +365,596 @@ void UserManager::setup( const fs::path &path )
 	setBounds( mSourceBounds );
 }
 
-void UserManager::openKinect( const fs::path &path )
+std::string UserManager::getSourcePath( int type ) const
 {
-	try
+	if ( type == SkeletonSource::SOURCE_RECORDING )
+		return mRecordingPath;
+	else if ( type == SkeletonSource::SOURCE_JOINT_STREAM )
+		return mJointStreamPath;
+	else
+		return "";
+}
+
+void UserManager::openSource()
+{
+	closeSource();
+
+	mOpenSourceType = mSourceType;
+	mOpenSourcePath = getSourcePath( mSourceType );
+
+	// sensor i reads the file i, the files are reused if there are less than sensors
+	vector< string > paths;
+	if ( ! mOpenSourcePath.empty() )
+		paths = split( mOpenSourcePath, ";" );
+
+#if USE_MOCK_NI
+	// the stand-in devices generate the users of the synthetic params
+	if ( mSourceType == SkeletonSource::SOURCE_DEVICE )
 	{
-		mndl::ni::OpenNI kinect;
-		if ( path.empty() )
-			kinect = OpenNI( OpenNI::Device() );
-		else
-			kinect = OpenNI( path );
+		reserveUsers( mSyntheticOptions.userCount * mSensorCount + 1 );
+		mndl::ni::OpenNI::setDeviceOptions( mSyntheticOptions );
+	}
+#endif
+	// more users than a sensor tracks, plus the mouse user
+	if ( mSourceType == SkeletonSource::SOURCE_SYNTHETIC )
+		reserveUsers( mSyntheticOptions.userCount * mSensorCount + 1 );
+
+	mFusion.setSensorCount( mSensorCount );
+	vector< SourceFactory > factories;
+	for ( int i = 0; i < mSensorCount; i++ )
+	{
+		fs::path path;
+		if ( ! paths.empty() )
+			path = paths[ i % paths.size() ];
+
+		// relative files are looked up in the assets as well
+		if ( ! path.empty() && path.is_relative() && ! fs::exists( path ) )
 		{
-			std::lock_guard< std::mutex > lock( mMutex );
-			mNI = kinect;
+			fs::path assetPath = getAssetPath( path );
+			if ( ! assetPath.empty() )
+				path = assetPath;
 		}
+
+		// each synthetic sensor sees other users
+		SyntheticSource::Options options = mSyntheticOptions;
+		options.seed += i;
+		factories.push_back( bind( &UserManager::createSource, SkeletonSource::Type( mSourceType ), path, i, options ) );
+		mSensors.push_back( SensorRef( new Sensor() ) );
+	}
+
+	// the extrinsics are set before the first frames
+	updateSensors();
+	for ( int i = 0; i < mSensorCount; i++ )
+		mSensors[ i ]->thread = thread( bind( &UserManager::trackerThread, this, mSensors[ i ], factories[ i ], i == 0 ) );
+}
+
+SkeletonSourceRef UserManager::createSource( SkeletonSource::Type type, const fs::path &path, int device,
+											 const SyntheticSource::Options &options )
+{
+	if ( type == SkeletonSource::SOURCE_SYNTHETIC )
+		return SkeletonSourceRef( new SyntheticSource( options ) );
+	else
+		return SkeletonSource::create( type, path, device );
+}
+
+void UserManager::closeSource()
+{
+	stopTracker();
+	mFusion.setSensorCount( 0 );
+
+	vector< unsigned > userIds;
+	for( Users::const_iterator it = mUsers.begin(); it != mUsers.end(); ++it )
+	{
+		// the mouse user stays
+		if( it->first != 0 )
+			userIds.push_back( it->first );
 	}
-	catch ( ... )
+	for( vector< unsigned >::const_iterator it = userIds.begin(); it != userIds.end(); ++it )
+		destroyUser( *it );
+
+	mJointFilter.reset();
+	mPredictFrame.joints.clear();
+	mOpenSourceType = -1;
+}
+
+void UserManager::updateSensors()
+{
+	Rectf stage( 0, 0, 640, 480 ); // kinect image rect without sensors
+	for ( size_t i = 0; i < mSensors.size(); i++ )
 	{
-		if ( path.empty() )
-			mKinectProgress = "No device detected";
+		SensorFusion::Extrinsics extrinsics( Vec2f( mSensorX[ i ], mSensorY[ i ] ), mSensorScale[ i ], toRadians( mSensorRotation[ i ] ) );
+		Rectf bounds = extrinsics.getBounds();
+		if ( i == 0 )
+			stage = bounds;
 		else
-			mKinectProgress = "Recording not found";
-		return;
+			stage.include( bounds );
+
+		Sensor &sensor = *mSensors[ i ];
+		Sensor::Params params;
+		params.extrinsics = extrinsics;
+		params.mirrored = mVideoMirrored;
+		params.videoShow = mVideoShow;
+		if ( ! sensor.paramsSent || ( params != sensor.sentParams ) )
+		{
+			std::lock_guard< std::mutex > lock( sensor.mutex );
+			sensor.params = params;
+			sensor.sentParams = params;
+			sensor.paramsSent = true;
+		}
+
+		// published by the sensor thread without locking
+		int state = sensor.state.load( boost::memory_order_acquire );
+		int retries = sensor.retries.load( boost::memory_order_acquire );
+		if ( ( state != sensor.shownState ) || ( retries != sensor.shownRetries ) )
+		{
+			sensor.shownState = state;
+			sensor.shownRetries = retries;
+			mStatusChanged = true;
+		}
 	}
 
-	if ( path.empty() )
-		mKinectProgress = "Connected";
-	else
-		mKinectProgress = "Recording loaded";
+	// the status is only rebuilt when it changes
+	if ( mStatusChanged && ! mSensors.empty() )
+	{
+		string status;
+		for ( size_t i = 0; i < mSensors.size(); i++ )
+		{
+			const Sensor &sensor = *mSensors[ i ];
+			string sensorStatus = Sensor::sStateNames[ sensor.shownState ];
+			if ( ( sensor.shownState == Sensor::STATE_LOST ) && ! sensor.status.empty() )
+				sensorStatus += ", " + sensor.status;
+			if ( sensor.shownRetries > 0 )
+				sensorStatus += " (retry " + toString( sensor.shownRetries ) + ")";
+
+			if ( mSensors.size() == 1 )
+				status = sensorStatus;
+			else
+				status += ( i ? ", " : "" ) + toString( i + 1 ) + ": " + sensorStatus;
+		}
+		mKinectProgress = status;
+	}
+	mStatusChanged = false;
+
+	mFusion.setDistance( mFusionDistance );
 
+	if ( ( stage.x1 != mStageRect.x1 ) || ( stage.y1 != mStageRect.y1 ) ||
+		 ( stage.x2 != mStageRect.x2 ) || ( stage.y2 != mStageRect.y2 ) )
 	{
-		std::lock_guard< std::mutex > lock( mMutex );
-		mNI.setDepthAligned();
-		mNI.start();
-		mNIUserTracker = mNI.getUserTracker();
-		mNIUserTracker.addListener( this );
+		mStageRect = stage;
+		setBounds( mOutputRect );
 	}
 }
 
-void UserManager::update()
+void UserManager::stopTracker()
 {
-	for( Users::const_iterator it = mUsers.begin(); it != mUsers.end(); ++it )
+	for ( vector< SensorRef >::const_iterator it = mSensors.begin(); it != mSensors.end(); ++it )
 	{
-		UserRef user = it->second;
+		std::lock_guard< std::mutex > lock( ( *it )->mutex );
+		( *it )->quit = true;
+	}
+	if ( mSensors.empty() )
+		return;
 
-		user->update();
+	// a thread opening a source can take seconds to quit, the new sensors start meanwhile
+	{
+		std::lock_guard< std::mutex > lock( mReclaimMutex );
+		mReclaimSensors.insert( mReclaimSensors.end(), mSensors.begin(), mSensors.end() );
 	}
+	mReclaimCond.notify_all();
+	mSensors.clear();
+}
 
+bool UserManager::getTrackerQuit( Sensor &sensor )
+{
+	std::lock_guard< std::mutex > lock( sensor.mutex );
+	return sensor.quit;
+}
+
+void UserManager::setTrackerState( Sensor &sensor, Sensor::State state, int retries )
+{
+	sensor.retries.store( retries, boost::memory_order_release );
+	sensor.state.store( state, boost::memory_order_release );
+}
+
+UserManager::TrackerMessage *UserManager::beginMessage( Sensor &sensor )
+{
+	TrackerMessage *message;
+	while ( ( ( message = sensor.ring.beginWrite() ) == NULL ) && ! getTrackerQuit( sensor ) )
+		ci::sleep( 1.f );
+	return message;
+}
+
+void UserManager::trackerThread( SensorRef sensor, SourceFactory factory, bool video )
+{
+	vector< unsigned > users; // reported by the source and not lost yet
+	double retryDelay = sRetryDelay;
+	int retries = 0;
+
+	while ( ! getTrackerQuit( *sensor ) )
 	{
-		std::lock_guard< std::mutex > lock( mMutex );
-		if ( !mNI )
+		setTrackerState( *sensor, ( retries == 0 ) ? Sensor::STATE_CONNECTING : Sensor::STATE_RECONNECTING, retries );
+
+		SkeletonSourceRef source = factory();
+		bool opened = source->open();
+
+		TrackerMessage *message = beginMessage( *sensor );
+		if ( ! message )
 			return;
+		message->type = TrackerMessage::STATUS;
+		message->status = source->getStatus();
+		message->frame.joints.clear();
+		sensor->ring.endWrite();
+
+		if ( opened )
+		{
+			retries = 0;
+			setTrackerState( *sensor, Sensor::STATE_RUNNING, retries );
+			retryDelay = sRetryDelay;
+
+			if ( ! readSource( *sensor, source, video, users ) )
+				return;
+
+			console() << "skeleton source lost, no frames" << endl;
+			message = beginMessage( *sensor );
+			if ( ! message )
+				return;
+			message->type = TrackerMessage::STATUS;
+			message->status = "No frames";
+			message->frame.joints.clear();
+			sensor->ring.endWrite();
+		}
+
+		// the users of the lost source are not coming back with the same ids
+		for ( vector< unsigned >::const_iterator it = users.begin(); it != users.end(); ++it )
+		{
+			message = beginMessage( *sensor );
+			if ( ! message )
+				return;
+			message->type = TrackerMessage::USER_LOST;
+			message->userId = *it;
+			message->frame.joints.clear();
+			sensor->ring.endWrite();
+		}
+		users.clear();
+
+		// the device is closed while waiting
+		source.reset();
+		setTrackerState( *sensor, Sensor::STATE_LOST, ++retries );
+		for ( double waited = 0.0; ( waited < retryDelay ) && ! getTrackerQuit( *sensor ); waited += .01 )
+			ci::sleep( 10.f );
+		retryDelay = math< double >::min( retryDelay * 2, sMaxRetryDelay );
 	}
+}
 
-	mNIUserTracker.setSmoothing( mSkeletonSmoothing );
-	if ( mNI.isMirrored() != mVideoMirrored )
-		mNI.setMirrored( mVideoMirrored );
+bool UserManager::readSource( Sensor &sensor, SkeletonSourceRef source, bool video, vector< unsigned > &users )
+{
+	JointFrame frame;
+	vector< SkeletonSource::Event > events;
+	Sensor::Params params;
+	double timeout = source->getLostTimeout();
+	double frameTime = getElapsedSeconds();
 
-	vector< unsigned > users = mNIUserTracker.getUsers();
-	for( vector< unsigned >::const_iterator it = users.begin(); it != users.end(); ++it )
+	for ( ;; )
 	{
-		unsigned userId = *it;
-		UserRef user = findUser( userId );
-		if( ! user )
+		// the params are copied by updateSensors
+		{
+			std::lock_guard< std::mutex > lock( sensor.mutex );
+			if ( sensor.quit )
+				break;
+			params = sensor.params;
+		}
+
+		source->setMirrored( params.mirrored );
+
+		// the video of the first sensor is copied only while it is shown, the upload is done by drawBody
+		if ( video && params.videoShow )
+			source->readVideo( mNIVideo );
+
+		bool hasFrame = source->read( &frame, &events );
+
+		// the user events go before the joints, they are never dropped
+		for ( vector< SkeletonSource::Event >::const_iterator it = events.begin(); it != events.end(); ++it )
+		{
+			vector< unsigned >::iterator user = std::find( users.begin(), users.end(), it->second );
+			if ( ( it->first == SkeletonSource::USER_NEW ) && ( user == users.end() ) )
+				users.push_back( it->second );
+			else if ( ( it->first == SkeletonSource::USER_LOST ) && ( user != users.end() ) )
+				users.erase( user );
+
+			TrackerMessage *message = beginMessage( sensor );
+			if ( ! message )
+				return false;
+
+			message->type = ( it->first == SkeletonSource::USER_NEW ) ? TrackerMessage::USER_NEW : TrackerMessage::USER_LOST;
+			message->userId = it->second;
+			message->frame.joints.clear();
+			sensor.ring.endWrite();
+		}
+		events.clear();
+
+		if ( ! hasFrame )
+		{
+			// an unplugged device sends no frames and no errors
+			if ( ( timeout > 0.0 ) && ( getElapsedSeconds() - frameTime > timeout ) )
+				return true;
+
+			ci::sleep( 1.f );
 			continue;
+		}
+		frameTime = getElapsedSeconds();
+
+		// the frame is dropped if the render thread falls behind
+		TrackerMessage *message = sensor.ring.beginWrite();
+		if ( ! message )
+			continue;
+
+		message->type = TrackerMessage::FRAME;
+		message->userId = 0;
+		message->frame.time = frame.time;
+		message->frame.joints.assign( frame.joints.begin(), frame.joints.end() );
+		for ( vector< JointFrame::Joint >::iterator it = message->frame.joints.begin(); it != message->frame.joints.end(); ++it )
+			it->pos = params.extrinsics.map( it->pos );
+		sensor.ring.endWrite();
+	}
+
+	return false;
+}
+
+void UserManager::strokeThread()
+{
+	while ( true )
+	{
+		int steps;
+		double stepTime;
+		float alpha;
+		{
+			std::unique_lock< std::mutex > lock( mStrokeMutex );
+			while ( ! mStrokeJob && ! mStrokeQuit )
+				mStrokeCond.wait( lock );
+			if ( mStrokeQuit )
+				return;
+			steps = mStrokeSteps;
+			stepTime = mStrokeStepTime;
+			alpha = mStrokeAlpha;
+		}
+
+		for ( int i = 0; i < steps; i++ )
+		{
+			mStrokeTime += stepTime;
+			mRecorder.setTime( mStrokeTime );
+			step();
+		}
+
+		// users and strokes are added in the same order as they were drawn one by one
+		StrokeBatch &batch = mStrokeBatches[ 1 - mStrokeFront ];
+		batch.clear( StrokeManager::getGpuRibbon() );
+		for( Users::const_iterator it = mUsers.begin(); it != mUsers.end(); ++it )
+		{
+			UserRef user = it->second;
+
+			user->buildStrokes( alpha, batch );
+		}
+		batch.setBuildTime( app::getElapsedSeconds() );
 
-		user->clearPoints();
-		for( Joints::const_iterator it = mJoints.begin(); it != mJoints.end(); ++it )
 		{
-			XnSkeletonJoint jointId = *it;
-			float conf = 0;
-			Vec2f jointPos = mNIUserTracker.getJoint2d( userId, jointId, &conf );
+			std::lock_guard< std::mutex > lock( mStrokeMutex );
+			mStrokeJob = false;
+			mStrokeBuilt = true;
+		}
+		mStrokeCond.notify_all();
+	}
+}
+
+void UserManager::updateStrokes( int steps, double stepTime, float alpha, const Calibrate &calibrate )
+{
+	waitStrokes();
+
+	// the stroke thread is idle, the batch built in the last frame is drawn in this one
+	if ( mStrokeBuilt )
+	{
+		mStrokeFront = 1 - mStrokeFront;
+		mStrokeBuilt = false;
+	}
+
+	for( Users::const_iterator it = mUsers.begin(); it != mUsers.end(); ++it )
+	{
+		UserRef user = it->second;
+
+		user->updateTransform( calibrate );
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( mStrokeMutex );
+		mStrokeSteps = steps;
+		mStrokeStepTime = stepTime;
+		mStrokeAlpha = alpha;
+		mStrokeJob = true;
+	}
+	mStrokeCond.notify_all();
+}
+
+void UserManager::waitStrokes()
+{
+	std::unique_lock< std::mutex > lock( mStrokeMutex );
+	while ( mStrokeJob )
+		mStrokeCond.wait( lock );
+}
+
+void UserManager::step()
+{
+	StrokeManager::simulate();
+
+	for( Users::const_iterator it = mUsers.begin(); it != mUsers.end(); ++it )
+	{
+		UserRef user = it->second;
+
+		user->update();
+	}
+}
+
+void UserManager::update()
+{
+	if ( mSourceEnabled && ( mSourceReopen || ( mOpenSourceType < 0 ) ) )
+	{
+		mSourceReopen = false;
+		openSource();
+	}
 
-			if( conf > .9 )
+	updateSensors();
+
+	// the messages of each sensor are applied in order at the frame boundary
+	bool newFrame = false;
+	for ( size_t i = 0; i < mSensors.size(); i++ )
+	{
+		SpscRing< TrackerMessage > &ring = mSensors[ i ]->ring;
+		TrackerMessage *message;
+		while ( ( message = ring.beginRead() ) != NULL )
+		{
+			switch ( message->type )
 			{
-				user->addPos( jointId, mOutputMapping.map( jointPos ));
+			case TrackerMessage::USER_NEW :
+				// the fusion binds the user with its first joints
+				break;
+
+			case TrackerMessage::USER_LOST :
+				mFusion.lostUser( int( i ), message->userId, &mFusionEvents );
+				break;
+
+			case TrackerMessage::FRAME :
+				mFusion.setFrame( int( i ), message->frame );
+				newFrame = true;
+				break;
+
+			case TrackerMessage::STATUS :
+				mSensors[ i ]->status = message->status;
+				mStatusChanged = true;
+				break;
 			}
+
+			ring.endRead();
 		}
 	}
+
+	// the last frames of the sensors are fused once per frame
+	if ( newFrame )
+		mFusion.fuse( &mFusedFrame, &mFusionEvents, sMaxSensorLag );
+
+	for ( vector< SkeletonSource::Event >::const_iterator it = mFusionEvents.begin(); it != mFusionEvents.end(); ++it )
+	{
+		if ( it->first == SkeletonSource::USER_NEW )
+			createUser( it->second );
+		else
+			destroyUser( it->second );
+	}
+	mFusionEvents.clear();
+
+	if ( newFrame )
+	{
+		mJointRecorder.write( mFusedFrame );
+		applyJoints( mFusedFrame );
+	}
 }
 
-void UserManager::drawStroke( const Calibrate &calibrate )
+void UserManager::replayJoints( const JointFrame &frame )
 {
-	gl::enableAlphaBlending();
+	// users come and go with their joints
+	vector< unsigned > lostUsers;
+	for( Users::const_iterator it = mUsers.begin(); it != mUsers.end(); ++it )
+	{
+		bool found = false;
+		for( vector< JointFrame::Joint >::const_iterator jt = frame.joints.begin(); jt != frame.joints.end() && ! found; ++jt )
+			found = ( jt->userId == it->first );
+		if( ! found )
+			lostUsers.push_back( it->first );
+	}
+	for( vector< unsigned >::const_iterator it = lostUsers.begin(); it != lostUsers.end(); ++it )
+		destroyUser( *it );
 
-	for( Users::iterator it = mUsers.begin(); it != mUsers.end(); ++it )
+	for( vector< JointFrame::Joint >::const_iterator it = frame.joints.begin(); it != frame.joints.end(); ++it )
+		createUser( it->userId );
+
+	applyJoints( frame );
+}
+
+void UserManager::applyJoints( const JointFrame &frame )
+{
+	mJointTime = frame.time;
+
+	const vector< Vec2f > *positions = NULL;
+	if( mJointFilterEnabled )
+	{
+		for( int i = 0; i < JointTable::sCount; i++ )
+			mJointFilter.setParams( i, mFilterMinCutoff[ i ], mFilterBeta[ i ] );
+		positions = &mJointFilter.apply( frame );
+		mPredictFrame = frame;
+	}
+	else
 	{
-		it->second->drawStroke( calibrate );
+		mJointFilter.reset();
+		mPredictFrame.joints.clear();
 	}
 
-	gl::disableAlphaBlending();
+	addJoints( frame, positions );
 }
 
-void UserManager::drawBody( const Calibrate &calibrate )
+void UserManager::predictJoints( double time )
 {
-	gl::enableAlphaBlending();
+	if( ! mJointFilterEnabled || ( mPrediction <= 0.f ) || mPredictFrame.joints.empty())
+		return;
 
+	// the joints move on between the sensor frames, so every frame gets new targets
+	addJoints( mPredictFrame, &mJointFilter.predict( time + mPrediction, mPrediction + sMaxFrameDelay ));
+}
 
-	if( mNI && mNI.checkNewVideoFrame())
+void UserManager::addJoints( const JointFrame &frame, const vector< Vec2f > *positions )
+{
+	UserRef user;
+	unsigned userId = 0;
+	for( vector< JointFrame::Joint >::const_iterator it = frame.joints.begin(); it != frame.joints.end(); ++it )
 	{
-		mNITexture = gl::Texture( mNI.getVideoImage() );
+		// joints of a user are consecutive
+		if( ( it == frame.joints.begin()) || ( it->userId != userId ))
+		{
+			userId = it->userId;
+			user = findUser( userId );
+			if( user )
+				user->clearPoints();
+		}
+
+		if( user && ( it->confidence > JointFilter::sMinConfidence ))
+		{
+			Vec2f pos = positions ? ( *positions )[ it - frame.joints.begin() ] : it->pos;
+			user->addPos( XnSkeletonJoint( it->jointId ), mOutputMapping.map( pos ), it->confidence, frame.time );
+		}
 	}
+}
+
+void UserManager::drawStroke()
+{
+	if( ! mBrushes )
+		return;
+
+	gl::enableAlphaBlending();
+
+	mBrushes.bind();
+	mStrokeBatches[ mStrokeFront ].draw();
+	mBrushes.unbind();
 
-	if( mNITexture && mVideoShow )
+	gl::disableAlphaBlending();
+}
+
+void UserManager::drawBody( const Calibrate &calibrate )
+{
+	gl::enableAlphaBlending();
+
+	if( mVideoShow )
 	{
-		gl::color( Color::white() );
-		gl::draw( mNITexture, mSourceBounds );
+		mNIVideo.update();
+		if( mNIVideo.getTexture() )
+		{
+			gl::color( Color::white() );
+			gl::draw( mNIVideo.getTexture(), mSourceBounds );
+		}
 	}
 
 	for( Users::iterator it = mUsers.begin(); it != mUsers.end(); ++it )
@@ -347,7 +969,7 @@ void UserManager::setBounds( const Rectf &rect )
 {
 	mOutputRect = rect;
 
-	Rectf kRect( 0, 0, 640, 480 ); // kinect image rect
+	Rectf kRect = mStageRect;
 	Rectf dRect = kRect.getCenteredFit( mOutputRect, true );
 	if( mOutputRect.getAspectRatio() > dRect.getAspectRatio() )
 		dRect.scaleCentered( mOutputRect.getWidth() / dRect.getWidth() );
@@ -357,6 +979,15 @@ void UserManager::setBounds( const Rectf &rect )
 	mOutputMapping = RectMapping( kRect, dRect, true );
 }
 
+void UserManager::setSyntheticOptions( const SyntheticSource::Options &options )
+{
+	mSyntheticOptions = options;
+	mSyntheticOptions.userCount = math< int >::clamp( options.userCount, 1, sMaxSyntheticUsers );
+	mSyntheticOptions.churn = math< float >::clamp( options.churn, 0.f, float( sMaxSyntheticChurn ) );
+	mSyntheticOptions.seed = math< int >::max( options.seed, 0 );
+	mSourceReopen = true;
+}
+
 void UserManager::setSourceBounds( const Area &area )
 {
 	mSourceBounds = area;
@@ -368,6 +999,9 @@ void UserManager::clearStrokes()
 	{
 		it->second->clearStrokes();
 	}
+
+	mStrokeBatches[ 0 ].clear();
+	mStrokeBatches[ 1 ].clear();
 }
 
 void UserManager::createUser( unsigned userId )
@@ -375,106 +1009,110 @@ void UserManager::createUser( unsigned userId )
 	if( findUser( userId ))
 		return;
 
-	mUsers[ userId ] = UserRef( new User( this ));
+	UserRef user = acquireUser();
+	mUsers[ userId ] = user;
+	user->setRecorder( &mRecorder, userId );
 
-	for( Joints::const_iterator it = mJoints.begin(); it != mJoints.end(); ++it )
-	{
-		XnSkeletonJoint jointId = *it;
-
-		if( jointId == XN_SKEL_NECK
-		 || jointId == XN_SKEL_LEFT_HIP
-		 || jointId == XN_SKEL_RIGHT_HIP )
-			continue;
-
-		mUsers[ userId ]->addStroke( jointId );
-	}
+	for( int i = 0; i < JointTable::sStrokeCount; i++ )
+		user->addStroke( JointTable::sJoints[ i ].id );
 }
 
 void UserManager::destroyUser( unsigned userId )
 {
-	if( ! findUser( userId ))
+	Users::iterator it = mUsers.find( userId );
+	if( it == mUsers.end())
 		return;
 
-	mUsers.erase( userId );
+	UserRef user = it->second;
+	mUsers.erase( it );
+	releaseUser( user );
 }
 
-UserManager::UserRef UserManager::findUser( unsigned userId )
+void UserManager::reserveUsers( size_t count )
 {
-	Users::iterator it = mUsers.find( userId );
-	if( it == mUsers.end())
-		return UserRef();
+	mUserPoolSize = std::max( mUserPoolSize, count );
 
-	return it->second;
+	while( mUserPool.size() + mUsers.size() < mUserPoolSize )
+	{
+		UserRef user( new User( this ));
+		for( int j = 0; j < JointTable::sStrokeCount; j++ )
+			user->reserveStroke( JointTable::sJoints[ j ].id );
+		mUserPool.push_back( user );
+	}
 }
 
-bool UserManager::getStrokeActive( XnSkeletonJoint jointId )
+UserManager::UserRef UserManager::acquireUser()
 {
-	switch( jointId )
-	{
-	case XN_SKEL_LEFT_HAND      : return mStrokeActive[ LEFT_HAND      ];
-	case XN_SKEL_LEFT_SHOULDER  : return mStrokeActive[ LEFT_SHOULDER  ];
-	case XN_SKEL_HEAD           : return mStrokeActive[ HEAD           ];
-	case XN_SKEL_RIGHT_HAND     : return mStrokeActive[ RIGHT_HAND     ];
-	case XN_SKEL_RIGHT_SHOULDER : return mStrokeActive[ RIGHT_SHOULDER ];
-	case XN_SKEL_TORSO          : return mStrokeActive[ TORSO          ];
-	case XN_SKEL_LEFT_KNEE      : return mStrokeActive[ LEFT_KNEE      ];
-	case XN_SKEL_RIGHT_KNEE     : return mStrokeActive[ RIGHT_KNEE     ];
-	case XN_SKEL_LEFT_FOOT      : return mStrokeActive[ LEFT_FOOT      ];
-	case XN_SKEL_RIGHT_FOOT     : return mStrokeActive[ RIGHT_FOOT     ];
-	default: return false;
-	}
+	if( mUserPool.empty())
+		return UserRef( new User( this ));
 
-	return false;
+	UserRef user = mUserPool.back();
+	mUserPool.pop_back();
+	return user;
 }
 
-gl::Texture UserManager::getStrokeBrush( XnSkeletonJoint jointId )
+void UserManager::releaseUser( UserRef user )
 {
-	switch( jointId )
+	// the strokes give back their simulation slots here, only memory is freed on the reclaim thread
+	user->reset();
+
+	if( mUserPool.size() < mUserPoolSize )
 	{
-	case XN_SKEL_LEFT_HAND      : if( mStrokeSelect[ LEFT_HAND      ] != 0 ) return mBrushes[ mStrokeSelect[ LEFT_HAND      ] - 1 ].second; break;
-	case XN_SKEL_LEFT_SHOULDER  : if( mStrokeSelect[ LEFT_SHOULDER  ] != 0 ) return mBrushes[ mStrokeSelect[ LEFT_SHOULDER  ] - 1 ].second; break;
-	case XN_SKEL_HEAD           : if( mStrokeSelect[ HEAD           ] != 0 ) return mBrushes[ mStrokeSelect[ HEAD           ] - 1 ].second; break;
-	case XN_SKEL_RIGHT_HAND     : if( mStrokeSelect[ RIGHT_HAND     ] != 0 ) return mBrushes[ mStrokeSelect[ RIGHT_HAND     ] - 1 ].second; break;
-	case XN_SKEL_RIGHT_SHOULDER : if( mStrokeSelect[ RIGHT_SHOULDER ] != 0 ) return mBrushes[ mStrokeSelect[ RIGHT_SHOULDER ] - 1 ].second; break;
-	case XN_SKEL_TORSO          : if( mStrokeSelect[ TORSO          ] != 0 ) return mBrushes[ mStrokeSelect[ TORSO          ] - 1 ].second; break;
-	case XN_SKEL_LEFT_KNEE      : if( mStrokeSelect[ LEFT_KNEE      ] != 0 ) return mBrushes[ mStrokeSelect[ LEFT_KNEE      ] - 1 ].second; break;
-	case XN_SKEL_RIGHT_KNEE     : if( mStrokeSelect[ RIGHT_KNEE     ] != 0 ) return mBrushes[ mStrokeSelect[ RIGHT_KNEE     ] - 1 ].second; break;
-	case XN_SKEL_LEFT_FOOT      : if( mStrokeSelect[ LEFT_FOOT      ] != 0 ) return mBrushes[ mStrokeSelect[ LEFT_FOOT      ] - 1 ].second; break;
-	case XN_SKEL_RIGHT_FOOT     : if( mStrokeSelect[ RIGHT_FOOT     ] != 0 ) return mBrushes[ mStrokeSelect[ RIGHT_FOOT     ] - 1 ].second; break;
-	default: return gl::Texture();
+		mUserPool.push_back( user );
+		return;
 	}
 
-	return gl::Texture();
+	{
+		std::lock_guard< std::mutex > lock( mReclaimMutex );
+		mReclaimUsers.push_back( user );
+	}
+	mReclaimCond.notify_all();
 }
 
-void UserManager::newUser( UserTracker::UserEvent event )
+void UserManager::reclaimThread()
 {
-	console() << "new user: " << event.id << endl;
-}
+	while ( true )
+	{
+		vector< UserRef > users;
+		vector< SensorRef > sensors;
+		{
+			std::unique_lock< std::mutex > lock( mReclaimMutex );
+			while ( mReclaimUsers.empty() && mReclaimSensors.empty() && ! mReclaimQuit )
+				mReclaimCond.wait( lock );
+			if ( mReclaimUsers.empty() && mReclaimSensors.empty() )
+				return;
+			users.swap( mReclaimUsers );
+			sensors.swap( mReclaimSensors );
+		}
+		// the users and their point storage are freed here
 
-void UserManager::calibrationBeg( UserTracker::UserEvent event )
-{
-	console() << "user calib beg: " << event.id << endl;
+		for ( vector< SensorRef >::const_iterator it = sensors.begin(); it != sensors.end(); ++it )
+		{
+			if ( ( *it )->thread.joinable() )
+				( *it )->thread.join();
+		}
+	}
 }
 
-void UserManager::calibrationEnd( UserTracker::UserEvent event )
+UserManager::UserRef UserManager::findUser( unsigned userId )
 {
-	console() << "app calib end: " << event.id << endl;
-	createUser( event.id );
-}
+	Users::iterator it = mUsers.find( userId );
+	if( it == mUsers.end())
+		return UserRef();
 
-void UserManager::lostUser( UserTracker::UserEvent event )
-{
-	console() << "lost user: " << event.id << endl;
-	destroyUser( event.id );
+	return it->second;
 }
 
 bool UserManager::mouseDown( ci::app::MouseEvent event )
 {
-	mUsers[ 0 ] = UserRef( new User( this ));
-	mUsers[ 0 ]->addStroke( XN_SKEL_LEFT_HAND );
+	destroyUser( 0 );
+
+	UserRef user = acquireUser();
+	mUsers[ 0 ] = user;
+	user->setRecorder( &mRecorder, 0 );
+	user->addStroke( XN_SKEL_LEFT_HAND );
 	RectMapping mapping( mSourceBounds, mOutputRect );
-	mUsers[ 0 ]->addPos( XN_SKEL_LEFT_HAND, mapping.map( event.getPos() ) );
+	user->addPos( XN_SKEL_LEFT_HAND, mapping.map( event.getPos() ), 1.f, app::getElapsedSeconds() );
 
 	return true;
 }
@@ -483,7 +1121,7 @@ bool UserManager::mouseDrag( ci::app::MouseEvent event )
 {
 	RectMapping mapping( mSourceBounds, mOutputRect );
 	if ( mUsers.find( 0 ) != mUsers.end() )
-	mUsers[ 0 ]->addPos( XN_SKEL_LEFT_HAND, mapping.map( event.getPos() ) );
+	mUsers[ 0 ]->addPos( XN_SKEL_LEFT_HAND, mapping.map( event.getPos() ), 1.f, app::getElapsedSeconds() );
 
 	return true;
 }
@@ -0,0 +1,129 @@
+#include <algorithm>
+
+#include "cinder/app/App.h"
+
+#include "JointTable.h"
+#include "OpenNISource.h"
+
+using namespace std;
+using namespace ci;
+using namespace ci::app;
+using namespace mndl::ni;
+
+OpenNISource::OpenNISource( const fs::path &path /* = "" */, int device /* = 0 */ )
+: mPath( path )
+, mDevice( device )
+{
+}
+
+bool OpenNISource::open()
+{
+	try
+	{
+		if ( mPath.empty() )
+			mNI = OpenNI( OpenNI::Device( mDevice ) );
+		else
+			mNI = OpenNI( mPath );
+	}
+	catch ( ... )
+	{
+		if ( mPath.empty() )
+			mStatus = "No device detected";
+		else
+			mStatus = "Recording not found";
+		return false;
+	}
+
+	if ( mPath.empty() )
+		mStatus = "Connected";
+	else
+		mStatus = "Recording loaded";
+
+	mNI.setDepthAligned();
+	mNI.start();
+	mNIUserTracker = mNI.getUserTracker();
+	mNIUserTracker.addListener( this );
+	// the joints are filtered by JointFilter
+	mNIUserTracker.setSmoothing( 0.f );
+
+	return true;
+}
+
+void OpenNISource::setMirrored( bool mirrored )
+{
+	if ( mNI.isMirrored() != mirrored )
+		mNI.setMirrored( mirrored );
+}
+
+void OpenNISource::readVideo( StreamTexture &video )
+{
+	if ( mNI.checkNewVideoFrame() )
+		video.write( mNI.getVideoImage() );
+}
+
+bool OpenNISource::read( JointFrame *frame, vector< Event > *events )
+{
+	size_t first = events->size();
+	{
+		std::lock_guard< std::mutex > lock( mEventMutex );
+		events->insert( events->end(), mEvents.begin(), mEvents.end() );
+		mEvents.clear();
+	}
+	for ( vector< Event >::const_iterator it = events->begin() + first; it != events->end(); ++it )
+	{
+		vector< unsigned >::iterator user = std::find( mTrackedUsers.begin(), mTrackedUsers.end(), it->second );
+		if ( ( it->first == USER_NEW ) && ( user == mTrackedUsers.end() ) )
+			mTrackedUsers.push_back( it->second );
+		else if ( ( it->first == USER_LOST ) && ( user != mTrackedUsers.end() ) )
+			mTrackedUsers.erase( user );
+	}
+
+	// the skeletons are updated with the depth frames
+	if ( ! mNI.checkNewDepthFrame() )
+		return false;
+
+	frame->time = getElapsedSeconds();
+	frame->joints.clear();
+
+	for( vector< unsigned >::const_iterator it = mTrackedUsers.begin(); it != mTrackedUsers.end(); ++it )
+	{
+		unsigned userId = *it;
+
+		for( int j = 0; j < JointTable::sCount; j++ )
+		{
+			XnSkeletonJoint jointId = JointTable::sJoints[ j ].id;
+			float conf = 0;
+			Vec2f jointPos = mNIUserTracker.getJoint2d( userId, jointId, &conf );
+
+			frame->joints.push_back( JointFrame::Joint( userId, jointId, jointPos, conf ));
+		}
+	}
+
+	return true;
+}
+
+void OpenNISource::newUser( UserTracker::UserEvent event )
+{
+	console() << "new user: " << event.id << endl;
+}
+
+void OpenNISource::calibrationBeg( UserTracker::UserEvent event )
+{
+	console() << "user calib beg: " << event.id << endl;
+}
+
+void OpenNISource::calibrationEnd( UserTracker::UserEvent event )
+{
+	console() << "app calib end: " << event.id << endl;
+
+	std::lock_guard< std::mutex > lock( mEventMutex );
+	mEvents.push_back( Event( USER_NEW, event.id ));
+}
+
+void OpenNISource::lostUser( UserTracker::UserEvent event )
+{
+	console() << "lost user: " << event.id << endl;
+
+	std::lock_guard< std::mutex > lock( mEventMutex );
+	mEvents.push_back( Event( USER_LOST, event.id ));
+}
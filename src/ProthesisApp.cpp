@@ -1,18 +1,19 @@
 #include <boost/logic/tribool.hpp>
 #include <boost/assign/std/vector.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "cinder/app/AppBasic.h"
 #include "cinder/Cinder.h"
 #include "cinder/Display.h"
 #include "cinder/gl/gl.h"
-#include "cinder/gl/GlslProg.h"
 #include "cinder/Rect.h"
 #include "AntTweakBar.h"
 #include "Calibrate.h"
-#include "Kaleidoscope.h"
+#include "Canvas.h"
+#include "FixedTimestep.h"
+#include "LatencyMonitor.h"
 #include "NIUser.h"
 #include "PParams.h"
-#include "Resources.h"
 #include "StrokeManager.h"
 #include "Utils.h"
 
@@ -45,16 +46,20 @@ class ProthesisApp : public AppBasic
 
 		void showAllParams( bool show );
 		void makeScreenshot();
+		void toggleRecording();
 
 	private:
 		UserManager   mUserManager;
 		Calibrate     mCalibrate;
 
-		gl::Fbo mFbo;
-		gl::GlslProg mBlendShader;
-		int mFboPingPongId; // 1 or 2
+		FixedTimestep mSimulationClock;
+		double        mLastTime;
+		float         mFrameTime; // seconds elapsed since the last frame
 
-		void clearFbo();
+		Canvas        mCanvas;
+
+		LatencyMonitor mLatency;
+		double        mDrawnJointTime; // acquisition time of the newest joints drawn in the last frame
 
 		enum MouseAction
 		{
@@ -63,16 +68,11 @@ class ProthesisApp : public AppBasic
 			MA_CALIBRATE = 2,
 		};
 
-		enum BlendModes
-		{
-			BLENDMODE_DARKEN = 0,
-			BLENDMODE_ERASE
-		};
-
 		// params
 		mndl::params::PInterfaceGl mParams;
 		float                mFps;
-		float                mFadeOutStrength;
+		float                mFadePerSecond;
+		float                mSimulationRate;
 		int                  mBlendmode;
 		MouseAction          mMouseAction;
 
@@ -85,8 +85,6 @@ class ProthesisApp : public AppBasic
 
 		void setSpanningWindow( bool spanning );
 		bool isSpanningWindow() const;
-
-		KaleidoscopeRef mKaleidoscope;
 };
 
 void ProthesisApp::prepareSettings(Settings *settings)
@@ -95,6 +93,7 @@ void ProthesisApp::prepareSettings(Settings *settings)
 }
 
 ProthesisApp::ProthesisApp() :
+	mDrawnJointTime( -1.0 ),
 	mSpanning( boost::logic::indeterminate )
 {
 }
@@ -113,12 +112,13 @@ void ProthesisApp::setup()
 	mParams.addText( "Debug" );
 	mParams.addParam( "Fps", &mFps, "", true );
 	mParams.addSeparator();
-	mParams.addPersistentParam( "Fade strength", &mFadeOutStrength, 0.995f, "min=0. max=1. step=0.001" );
+	mParams.addPersistentParam( "Fade per second", &mFadePerSecond, 0.74f, "min=0. max=1. step=0.001" );
+	mParams.addPersistentParam( "Simulation rate", &mSimulationRate, 60.f, "min=10 max=240 step=1" );
 
+	// persistent, so ProthesisRender draws the recordings the same way
 	vector< string > blendNames;
 	blendNames += "Darken", "Erase";
-	mBlendmode = BLENDMODE_DARKEN;
-	mParams.addParam( "Blendmode", blendNames, &mBlendmode );
+	mParams.addPersistentParam( "Blendmode", blendNames, &mBlendmode, Canvas::BLENDMODE_DARKEN );
 
 	vector< string > mouseActions;
 	mouseActions.push_back( "None"      );
@@ -130,13 +130,7 @@ void ProthesisApp::setup()
 
 	try
 	{
-#if USE_KINECT_RECORD == 0
 		mUserManager.setup();
-#else
-		// use openni recording
-		fs::path recordingPath = getAssetPath( "prothesis-capture.oni" );
-		mUserManager.setup( recordingPath );
-#endif /* USE_KINECT_RECORD */
 	}
 	catch ( const exception &exc )
 	{
@@ -144,42 +138,73 @@ void ProthesisApp::setup()
 		quit();
 	}
 
+	/* the skeleton source of the params is overridden by --device, --oni recording.oni, --joints joints.prjs
+	 * or --synthetic, the synthetic users are set by --users count, --churn users_per_second and --seed number.
+	 * --oni and --joints can be repeated, a sensor is opened for each file, --sensors count overrides it */
+	const vector< string > &args = getArgs();
+	SyntheticSource::Options synthetic = mUserManager.getSyntheticOptions();
+	string sourcePaths;
+	int sourcePathCount = 0;
+	int sensorCount = -1; // -1 if not given
+	try
+	{
+		for ( size_t i = 1; i < args.size(); i++ )
+		{
+			if ( args[ i ] == "--device" )
+				mUserManager.setSource( SkeletonSource::SOURCE_DEVICE );
+			else if ( ( ( args[ i ] == "--oni" ) || ( args[ i ] == "--joints" ) ) && ( i + 1 < args.size() ) )
+			{
+				SkeletonSource::Type type = ( args[ i ] == "--oni" ) ? SkeletonSource::SOURCE_RECORDING : SkeletonSource::SOURCE_JOINT_STREAM;
+				sourcePaths += ( sourcePathCount++ ? ";" : "" ) + args[ ++i ];
+				mUserManager.setSource( type, sourcePaths );
+			}
+			else if ( args[ i ] == "--synthetic" )
+				mUserManager.setSource( SkeletonSource::SOURCE_SYNTHETIC );
+			else if ( ( args[ i ] == "--sensors" ) && ( i + 1 < args.size() ) )
+				sensorCount = boost::lexical_cast< int >( args[ ++i ] );
+			else if ( ( args[ i ] == "--users" ) && ( i + 1 < args.size() ) )
+				synthetic.userCount = boost::lexical_cast< int >( args[ ++i ] );
+			else if ( ( args[ i ] == "--churn" ) && ( i + 1 < args.size() ) )
+				synthetic.churn = boost::lexical_cast< float >( args[ ++i ] );
+			else if ( ( args[ i ] == "--seed" ) && ( i + 1 < args.size() ) )
+				synthetic.seed = boost::lexical_cast< int >( args[ ++i ] );
+		}
+	}
+	catch ( const boost::bad_lexical_cast & )
+	{
+		// the options after the invalid one are ignored
+		console() << "invalid number in the arguments, usage: Prothesis [--device | --oni file | --joints file | --synthetic]"
+					 " [--sensors count] [--users count] [--churn users_per_second] [--seed number]" << endl;
+	}
+	// the values are clamped to the param ranges
+	mUserManager.setSyntheticOptions( synthetic );
+	if ( sensorCount != -1 )
+		mUserManager.setSensorCount( sensorCount );
+	else if ( sourcePathCount > 1 )
+		mUserManager.setSensorCount( sourcePathCount );
+
 // 	registerMouseDown( &mUserManager, &UserManager::mouseDown );
 // 	registerMouseUp( &mUserManager, &UserManager::mouseUp );
 // 	registerMouseDrag( &mUserManager, &UserManager::mouseDrag );
 
-	gl::Fbo::Format format;
-	format.enableDepthBuffer( false );
-	// FIXME: enabling MSAA results in white stripes between stroke triangles
-// 	format.setSamples( 4 );
-	format.setColorInternalFormat( GL_RGBA32F_ARB );
-	format.enableColorBuffer( true, 4 );
-	mFbo = gl::Fbo( 1024, 768, format );
-	clearFbo();
+	mCanvas.setup( 1024, 768 );
 
-	mUserManager.setFbo( mFbo );
+	mUserManager.setFbo( mCanvas.getFbo() );
 
-	StrokeManager::setup( mFbo.getSize());
+	StrokeManager::setup( mCanvas.getSize());
 	mCalibrate.setup();
 
-	mKaleidoscope = Kaleidoscope::create( mFbo.getWidth(), mFbo.getHeight() );
-
-	try
-	{
-		mBlendShader = gl::GlslProg( loadResource( RES_STROKE_VERT ),
-									 loadResource( RES_STROKE_FRAG ) );
-	}
-	catch( const std::exception &e )
-	{
-		app::console() << e.what() << std::endl;
-	}
-	mBlendShader.bind();
-	mBlendShader.uniform( "background", 0 );
-	mBlendShader.uniform( "brush", 1 );
-	mBlendShader.unbind();
+	fs::path logFolder = getAppPath();
+#ifdef CINDER_MAC
+	logFolder /= "..";
+#endif
+	mLatency.setup( logFolder / "latency.log" );
 
 	setSpanningWindow( true );
 	showAllParams( false );
+
+	mLastTime = getElapsedSeconds();
+	mFrameTime = 0.f;
 }
 
 void ProthesisApp::setupDisplays()
@@ -311,16 +336,16 @@ void ProthesisApp::keyDown( KeyEvent event )
 			break;
 
 		case KeyEvent::KEY_e:
-			mBlendmode = BLENDMODE_ERASE;
+			mBlendmode = Canvas::BLENDMODE_ERASE;
 			break;
 
 		case KeyEvent::KEY_d:
-			mBlendmode = BLENDMODE_DARKEN;
+			mBlendmode = Canvas::BLENDMODE_DARKEN;
 			break;
 
 		case KeyEvent::KEY_SPACE:
 			mUserManager.clearStrokes();
-			clearFbo();
+			mCanvas.clear();
 			break;
 
 		case KeyEvent::KEY_ESCAPE:
@@ -331,6 +356,10 @@ void ProthesisApp::keyDown( KeyEvent event )
 			makeScreenshot();
 			break;
 
+		case KeyEvent::KEY_r:
+			toggleRecording();
+			break;
+
 		default:
 			break;
 	}
@@ -371,84 +400,45 @@ void ProthesisApp::mouseUp(MouseEvent event)
 	}
 }
 
-void ProthesisApp::clearFbo()
-{
-	mFboPingPongId = 1;
-	mFbo.bindFramebuffer();
-	glDrawBuffer( GL_COLOR_ATTACHMENT1_EXT );
-	gl::clear( Color::white() );
-	glDrawBuffer( GL_COLOR_ATTACHMENT2_EXT );
-	gl::clear( Color::white() );
-	mFbo.unbindFramebuffer();
-}
-
 void ProthesisApp::update()
 {
 	mFps = getAverageFps();
+
+	double time = getElapsedSeconds();
+	mFrameTime = float( time - mLastTime );
+	mLastTime = time;
+
+	// the last frame has been swapped to the screen when the next update starts
+	mLatency.add( LatencyMonitor::STAGE_SWAP, mDrawnJointTime, time );
+	mLatency.update( time );
+
+	mCalibrate.update();
 	mUserManager.update();
+	mLatency.add( LatencyMonitor::STAGE_APPLY, mUserManager.getJointTime(), getElapsedSeconds() );
+	mUserManager.predictJoints( time );
+
+	// stroke physics runs at a fixed rate independent of the frame rate
+	mSimulationClock.setRate( mSimulationRate );
+	int steps = mSimulationClock.advance( mFrameTime );
+	mUserManager.updateStrokes( steps, mSimulationClock.getStep(), mSimulationClock.getAlpha(), mCalibrate );
 }
 
 void ProthesisApp::draw()
 {
-	// draw and blend strokes in fbo
-	mFbo.bindFramebuffer();
-	// draw strokes to attachment 0
-	glDrawBuffer( GL_COLOR_ATTACHMENT0_EXT );
-	if ( mBlendmode == BLENDMODE_DARKEN )
-		gl::clear( ColorA::white() );
-	else // BLENDMODE_ERASE
-		gl::clear( ColorA( 0, 0, 0, 0 ) );
-
-	gl::setMatricesWindow( mFbo.getSize(), false );
-	gl::setViewport( mFbo.getBounds() );
-
-	mUserManager.drawStroke( mCalibrate );
-
-	// blend it with previous frame to attachment pingpongid
-	glDrawBuffer( GL_COLOR_ATTACHMENT0_EXT + mFboPingPongId );
-	gl::color( Color::white() );
-	int otherId = ( mFboPingPongId == 1 ) ? 2 : 1;
-	mBlendShader.bind();
-	mBlendShader.uniform( "fadeout", mFadeOutStrength );
-	mBlendShader.uniform( "mode", mBlendmode );
-	mFbo.getTexture( otherId ).bind( 0 ); // bind previous frame to sampler 0
-	mFbo.getTexture( 0 ).bind( 1 ); // bind strokes to sampler 1
-	gl::drawSolidRect( mFbo.getBounds() );
-	mFbo.getTexture( otherId ).unbind();
-	mFbo.getTexture( 0 ).unbind( 1 );
-	mBlendShader.unbind();
-
-	mFbo.unbindFramebuffer();
-
-	// kaleidoscope
-
-	if ( mKaleidoscope->isEnabled() )
-	{
-		gl::Texture processed = mKaleidoscope->process( mFbo.getTexture( mFboPingPongId ) );
-		mFbo.bindFramebuffer();
-		glDrawBuffer( GL_COLOR_ATTACHMENT3 );
-		gl::clear();
-		gl::setViewport( mFbo.getBounds() );
-		gl::setMatricesWindow( mFbo.getSize(), false );
-		gl::color( Color::white() );
-		gl::draw( processed, mFbo.getBounds() );
-		mFbo.unbindFramebuffer();
-	}
+	// fade is given per second, apply the fraction of this frame
+	mCanvas.draw( mUserManager, math< float >::pow( mFadePerSecond, mFrameTime ), mBlendmode );
+
+	const StrokeBatch &batch = mUserManager.getStrokeBatch();
+	mLatency.add( LatencyMonitor::STAGE_EMIT, batch.getJointTime(), batch.getBuildTime() );
+	mLatency.add( LatencyMonitor::STAGE_DRAW, batch.getJointTime(), getElapsedSeconds() );
+	mDrawnJointTime = batch.getJointTime();
 
 	// draw fbo in window
 	gl::setMatricesWindow( getWindowSize() );
 	gl::setViewport( getWindowBounds() );
 
 	gl::clear( Color::black() );
-	if ( mKaleidoscope->isEnabled() )
-	{
-		gl::draw( mFbo.getTexture( 3 ), mOutputArea );
-	}
-	else
-	{
-		gl::draw( mFbo.getTexture( mFboPingPongId ), mOutputArea );
-	}
-	mFboPingPongId = otherId;
+	gl::draw( mCanvas.getTexture(), mOutputArea );
 
 	mUserManager.drawBody( mCalibrate );
 
@@ -461,6 +451,9 @@ void ProthesisApp::draw()
 	gl::drawSolidRect( normCoverMap.map( mCalibrate.getCoverBottom() ) );
 
 	mParams.draw();
+
+	// events between frames may change the users
+	mUserManager.waitStrokes();
 }
 
 void ProthesisApp::showAllParams( bool show )
@@ -479,15 +472,7 @@ void ProthesisApp::showAllParams( bool show )
 
 void ProthesisApp::makeScreenshot()
 {
-	Surface snapshot;
-	if ( mKaleidoscope->isEnabled() )
-	{
-		snapshot = Surface( mFbo.getTexture( 3 ) );
-	}
-	else
-	{
-		snapshot = Surface( mFbo.getTexture( mFboPingPongId ) );
-	}
+	Surface snapshot( mCanvas.getTexture() );
 
 	fs::path screenshotFolder = getAppPath();
 #ifdef CINDER_MAC
@@ -510,5 +495,42 @@ void ProthesisApp::makeScreenshot()
 	}
 }
 
+void ProthesisApp::toggleRecording()
+{
+	StrokeRecorder &recorder = mUserManager.getRecorder();
+	JointStreamWriter &jointRecorder = mUserManager.getJointRecorder();
+	if ( recorder.isRecording() || jointRecorder.isOpen() )
+	{
+		recorder.stop();
+		jointRecorder.close();
+		console() << "recording stopped, dropped stroke points: " << recorder.getDropped()
+				  << ", dropped joint frames: " << jointRecorder.getDropped() << endl;
+		return;
+	}
+
+	fs::path recordingFolder = getAppPath();
+#ifdef CINDER_MAC
+	recordingFolder /= "..";
+#endif
+	recordingFolder /= "recordings/";
+	fs::create_directory( recordingFolder );
+
+	// the joints can be rendered offline by ProthesisRender
+	string stamp = timeStamp();
+	fs::path recordingPath( recordingFolder / fs::path( "strokes-" + stamp + ".prst" ) );
+	fs::path jointPath( recordingFolder / fs::path( "joints-" + stamp + ".prjs" ) );
+
+	try
+	{
+		recorder.start( recordingPath );
+		jointRecorder.open( jointPath );
+		console() << "recording to " << recordingPath << " and " << jointPath << endl;
+	}
+	catch ( const std::exception &exc )
+	{
+		console() << exc.what() << endl;
+	}
+}
+
 CINDER_APP_BASIC( ProthesisApp, RendererGl() )
 
@@ -0,0 +1,350 @@
+#include <algorithm>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+
+#include <boost/lexical_cast.hpp>
+
+#include "cinder/app/AppBasic.h"
+#include "cinder/Cinder.h"
+#include "cinder/gl/gl.h"
+#include "cinder/ImageIo.h"
+#include "cinder/Surface.h"
+#include "cinder/Thread.h"
+#include "cinder/Timer.h"
+#include "Calibrate.h"
+#include "Canvas.h"
+#include "FixedTimestep.h"
+#include "JointStream.h"
+#include "NIUser.h"
+#include "PParams.h"
+#include "SoftCanvas.h"
+#include "StrokeManager.h"
+
+using namespace ci;
+using namespace ci::app;
+using namespace std;
+
+/** Offline renderer. Replays a joint stream recorded by Prothesis at a fixed
+ *  frame rate and writes the canvas frames as png images as fast as possible,
+ *  independent of the recording speed.
+ *
+ *  usage: ProthesisRender [--cpu|--compare] joints.prjs [output folder] [frame rate]
+ *
+ *  --cpu renders the canvas with SoftCanvas instead of gl, no gl resources are
+ *  created. --compare renders both and reports the frames where they differ
+ *  more than the tolerance to the console and to compare.txt in the output
+ *  folder, which ends with "passed" or "failed" (see scons/compare.sh).
+ *
+ *  The parameters are read from the same params.xml as the interactive app.
+ *  Cinder needs a window for the gl context, it is kept hidden and all
+ *  rendering goes to the canvas fbo.
+ */
+class ProthesisRenderApp : public AppBasic
+{
+	public:
+		ProthesisRenderApp();
+
+		void prepareSettings( Settings *settings );
+		void setup();
+		void shutdown();
+
+		void update();
+		void draw();
+
+	private:
+		bool renderFrame();
+		void writeFrames();
+		//! Writes compare.txt with the frames differing more than the tolerance.
+		void writeCompareReport();
+
+		UserManager   mUserManager;
+		Calibrate     mCalibrate;
+		Canvas        mCanvas;
+		SoftCanvas    mSoftCanvas;
+
+		enum RenderModes
+		{
+			RENDER_GL = 0,
+			RENDER_CPU,
+			RENDER_COMPARE
+		};
+		int           mRenderMode;
+		float         mMaxDifference;
+		std::vector< std::pair< int, float > > mFailedFrames; // frame and difference
+
+		FixedTimestep mSimulationClock;
+
+		std::shared_ptr< JointStreamReader > mJointStream;
+		JointFrame    mNextFrame;
+		bool          mHasNextFrame;
+
+		fs::path      mOutputFolder;
+		double        mFrameRate;
+		double        mTime;
+		int           mFrame;
+
+		// frames are written on a thread, the queue is bounded to keep memory flat
+		std::thread                               mWriterThread;
+		std::mutex                                mWriterMutex;
+		std::condition_variable                   mWriterCond;
+		std::deque< std::pair< fs::path, Surface > > mWriterQueue;
+		bool                                      mWriterQuit;
+		static const size_t                       sWriterQueueSize;
+		static const float                        sCompareTolerance;
+
+		// params, shared with the interactive app
+		mndl::params::PInterfaceGl mParams;
+		float                mFadePerSecond;
+		float                mSimulationRate;
+		int                  mBlendmode;
+};
+
+const size_t ProthesisRenderApp::sWriterQueueSize = 8;
+// allows for the texture filtering precision of the gpu
+const float  ProthesisRenderApp::sCompareTolerance = 4.f / 255.f;
+
+ProthesisRenderApp::ProthesisRenderApp()
+: mRenderMode( RENDER_GL )
+, mMaxDifference( 0.f )
+, mHasNextFrame( false )
+, mFrameRate( 30.0 )
+, mTime( 0.0 )
+, mFrame( 0 )
+, mWriterQuit( false )
+, mBlendmode( Canvas::BLENDMODE_DARKEN )
+{
+}
+
+void ProthesisRenderApp::prepareSettings( Settings *settings )
+{
+	settings->setWindowSize( 64, 64 );
+	settings->setResizable( false );
+	settings->setFrameRate( 1000.f );
+}
+
+void ProthesisRenderApp::setup()
+{
+	gl::disableVerticalSync();
+	getWindow()->hide();
+
+	vector< string > args;
+	for ( vector< string >::const_iterator it = getArgs().begin(); it != getArgs().end(); ++it )
+	{
+		if ( *it == "--cpu" )
+			mRenderMode = RENDER_CPU;
+		else if ( *it == "--compare" )
+			mRenderMode = RENDER_COMPARE;
+		else
+			args.push_back( *it );
+	}
+
+	if ( args.size() < 2 )
+	{
+		console() << "usage: ProthesisRender [--cpu|--compare] joints.prjs [output folder] [frame rate]" << endl;
+		quit();
+		return;
+	}
+
+	mOutputFolder = ( args.size() > 2 ) ? fs::path( args[ 2 ] ) : fs::path( "render" );
+	if ( args.size() > 3 )
+		mFrameRate = boost::lexical_cast< double >( args[ 3 ] );
+
+	// params
+	mndl::params::PInterfaceGl::load( std::string( "params.xml" ) );
+
+	mParams = mndl::params::PInterfaceGl( "Parameters", Vec2i( 200, 150 ), Vec2i( 16, 16 ) );
+	mParams.addPersistentParam( "Fade per second", &mFadePerSecond, 0.74f, "min=0. max=1. step=0.001" );
+	mParams.addPersistentParam( "Simulation rate", &mSimulationRate, 60.f, "min=10 max=240 step=1" );
+	vector< string > blendNames;
+	blendNames.push_back( "Darken" );
+	blendNames.push_back( "Erase" );
+	mParams.addPersistentParam( "Blendmode", blendNames, &mBlendmode, Canvas::BLENDMODE_DARKEN );
+
+	try
+	{
+		mJointStream = std::shared_ptr< JointStreamReader >( new JointStreamReader( args[ 1 ] ) );
+		mHasNextFrame = mJointStream->read( &mNextFrame );
+		fs::create_directories( mOutputFolder );
+	}
+	catch ( const std::exception &exc )
+	{
+		console() << exc.what() << endl;
+		quit();
+		return;
+	}
+
+	// the cpu renderer only needs the brush surfaces
+	bool gl = ( mRenderMode != RENDER_CPU );
+	mUserManager.setupReplay( gl );
+
+	Area bounds( 0, 0, 1024, 768 );
+	if ( gl )
+	{
+		mCanvas.setup( bounds.getWidth(), bounds.getHeight() );
+		mUserManager.setFbo( mCanvas.getFbo() );
+	}
+	if ( mRenderMode != RENDER_GL )
+	{
+		mSoftCanvas.setup( bounds.getWidth(), bounds.getHeight() );
+		mUserManager.setBounds( Rectf( Vec2f::zero(), Vec2f( mSoftCanvas.getSize() ) ) );
+	}
+	mUserManager.setSourceBounds( bounds );
+
+	StrokeManager::setup( bounds.getSize(), gl );
+	mCalibrate.setup();
+
+	mWriterThread = thread( bind( &ProthesisRenderApp::writeFrames, this ) );
+}
+
+void ProthesisRenderApp::shutdown()
+{
+	{
+		std::lock_guard< std::mutex > lock( mWriterMutex );
+		mWriterQuit = true;
+	}
+	mWriterCond.notify_all();
+	if ( mWriterThread.joinable() )
+		mWriterThread.join();
+}
+
+void ProthesisRenderApp::update()
+{
+	if ( ! mJointStream )
+		return;
+
+	// render as many frames as fit in a short time slice, so the app stays responsive
+	Timer timer( true );
+	while ( timer.getSeconds() < .1 )
+	{
+		if ( ! renderFrame() )
+		{
+			console() << "rendered " << mFrame << " frames to " << mOutputFolder << endl;
+			if ( mRenderMode == RENDER_COMPARE )
+				writeCompareReport();
+			mJointStream.reset();
+			quit();
+			return;
+		}
+	}
+}
+
+bool ProthesisRenderApp::renderFrame()
+{
+	if ( ! mHasNextFrame )
+		return false;
+
+	double frameTime = 1.0 / mFrameRate;
+	mTime += frameTime;
+
+	// all joint frames recorded until the end of this frame
+	while ( mHasNextFrame && ( mNextFrame.time <= mTime ) )
+	{
+		mUserManager.replayJoints( mNextFrame );
+		mHasNextFrame = mJointStream->read( &mNextFrame );
+	}
+	mUserManager.predictJoints( mTime );
+
+	mCalibrate.update();
+
+	mSimulationClock.setRate( mSimulationRate );
+	int steps = mSimulationClock.advance( frameTime );
+	mUserManager.updateStrokes( steps, mSimulationClock.getStep(), mSimulationClock.getAlpha(), mCalibrate );
+
+	float fadeout = math< float >::pow( mFadePerSecond, float( frameTime ) );
+	if ( mRenderMode != RENDER_CPU )
+		mCanvas.draw( mUserManager, fadeout, mBlendmode );
+	if ( mRenderMode != RENDER_GL )
+		mSoftCanvas.draw( mUserManager, fadeout, mBlendmode );
+
+	// the replay must not change the users while the stroke thread is running
+	mUserManager.waitStrokes();
+
+	char filename[ 32 ];
+	sprintf( filename, "frame-%06d.png", mFrame );
+	Surface frame;
+	if ( mRenderMode == RENDER_CPU )
+	{
+		frame = Surface( mSoftCanvas.getSurface() );
+	}
+	else
+	{
+		frame = Surface( mCanvas.getTexture() );
+		if ( mRenderMode == RENDER_COMPARE )
+		{
+			float difference = SoftCanvas::getMaxDifference( Surface32f( mCanvas.getTexture( false ) ),
+															 mSoftCanvas.getSurface() );
+			if ( difference > sCompareTolerance )
+			{
+				console() << "frame " << mFrame << " differs by " << difference << endl;
+				mFailedFrames.push_back( make_pair( mFrame, difference ) );
+			}
+			mMaxDifference = std::max( mMaxDifference, difference );
+		}
+	}
+
+	{
+		std::unique_lock< std::mutex > lock( mWriterMutex );
+		while ( mWriterQueue.size() >= sWriterQueueSize )
+			mWriterCond.wait( lock );
+		mWriterQueue.push_back( make_pair( mOutputFolder / fs::path( filename ), frame ) );
+	}
+	mWriterCond.notify_all();
+
+	mFrame++;
+	return true;
+}
+
+void ProthesisRenderApp::writeFrames()
+{
+	while ( true )
+	{
+		std::pair< fs::path, Surface > frame;
+		{
+			std::unique_lock< std::mutex > lock( mWriterMutex );
+			while ( mWriterQueue.empty() && ! mWriterQuit )
+				mWriterCond.wait( lock );
+			if ( mWriterQueue.empty() )
+				return;
+			frame = mWriterQueue.front();
+			mWriterQueue.pop_front();
+		}
+		mWriterCond.notify_all();
+
+		try
+		{
+			writeImage( frame.first, frame.second );
+		}
+		catch ( ... )
+		{
+			console() << "unable to save image file " << frame.first << endl;
+		}
+	}
+}
+
+void ProthesisRenderApp::writeCompareReport()
+{
+	bool passed = mFailedFrames.empty();
+	console() << "largest cpu and gl difference " << mMaxDifference << ( passed ? ", passed" : ", failed" ) << endl;
+
+	fs::path path = mOutputFolder / "compare.txt";
+	std::ofstream report( path.string().c_str() );
+	if ( ! report )
+	{
+		console() << "unable to write " << path << endl;
+		return;
+	}
+
+	report << "tolerance " << sCompareTolerance << endl;
+	for ( vector< pair< int, float > >::const_iterator it = mFailedFrames.begin(); it != mFailedFrames.end(); ++it )
+		report << "frame " << it->first << " differs by " << it->second << endl;
+	report << "largest difference " << mMaxDifference << endl;
+	report << ( passed ? "passed" : "failed" ) << endl;
+}
+
+void ProthesisRenderApp::draw()
+{
+	gl::clear( Color::black() );
+}
+
+CINDER_APP_BASIC( ProthesisRenderApp, RendererGl() )
@@ -0,0 +1,298 @@
+#include <algorithm>
+#include <limits>
+
+#include "cinder/CinderMath.h"
+
+#include "SensorFusion.h"
+
+using namespace std;
+using namespace ci;
+
+namespace
+{
+
+const Vec2f sImageSize( 640.f, 480.f ); // kinect image
+
+//! Returns if the joint belongs to the user of a lost binding.
+struct UserIs
+{
+	UserIs( unsigned userId ) : userId( userId ) {}
+	bool operator()( const JointFrame::Joint &joint ) const { return joint.userId == userId; }
+	unsigned userId;
+};
+
+} // anonymous namespace
+
+SensorFusion::Extrinsics::Extrinsics()
+: origin( Vec2f::zero() )
+, axisX( 1.f, 0.f )
+, axisY( 0.f, 1.f )
+{
+}
+
+SensorFusion::Extrinsics::Extrinsics( Vec2f offset, float scale, float rotation )
+{
+	float c = math< float >::cos( rotation );
+	float s = math< float >::sin( rotation );
+	axisX = scale * Vec2f( c, s );
+	axisY = scale * Vec2f( -s, c );
+
+	// rotated and scaled around the image center
+	Vec2f center = .5f * sImageSize;
+	origin = offset + center - center.x * axisX - center.y * axisY;
+}
+
+Rectf SensorFusion::Extrinsics::getBounds() const
+{
+	Rectf bounds( map( Vec2f::zero() ), map( Vec2f::zero() ) );
+	bounds.include( map( Vec2f( sImageSize.x, 0.f ) ) );
+	bounds.include( map( Vec2f( 0.f, sImageSize.y ) ) );
+	bounds.include( map( sImageSize ) );
+	return bounds;
+}
+
+SensorFusion::SensorFusion()
+: mNextId( 1 )
+, mDistance( 60.f )
+{
+	setSensorCount( 1 );
+}
+
+void SensorFusion::setSensorCount( int count )
+{
+	mFrames.resize( count );
+	for ( vector< JointFrame >::iterator it = mFrames.begin(); it != mFrames.end(); ++it )
+	{
+		it->time = -numeric_limits< double >::max();
+		it->joints.clear();
+	}
+	mBindings.clear();
+	mFused.clear();
+	mNextId = 1;
+}
+
+void SensorFusion::lostUser( int sensor, unsigned userId, vector< SkeletonSource::Event > *events )
+{
+	// the last frame of the sensor must not bind the user again
+	vector< JointFrame::Joint > &joints = mFrames[ sensor ].joints;
+	joints.erase( std::remove_if( joints.begin(), joints.end(), UserIs( userId ) ), joints.end() );
+
+	const Binding *binding = findBinding( sensor, userId );
+	if ( ! binding )
+		return;
+
+	unsigned fusedId = binding->fusedId;
+	mBindings.erase( mBindings.begin() + ( binding - &mBindings[ 0 ] ) );
+
+	for ( vector< Binding >::const_iterator it = mBindings.begin(); it != mBindings.end(); ++it )
+	{
+		if ( it->fusedId == fusedId )
+			return;
+	}
+	events->push_back( SkeletonSource::Event( SkeletonSource::USER_LOST, fusedId ) );
+}
+
+void SensorFusion::setFrame( int sensor, const JointFrame &frame )
+{
+	mFrames[ sensor ].time = frame.time;
+	mFrames[ sensor ].joints.assign( frame.joints.begin(), frame.joints.end() );
+}
+
+void SensorFusion::fuse( JointFrame *frame, vector< SkeletonSource::Event > *events, double maxAge )
+{
+	double newest = -numeric_limits< double >::max();
+	for ( vector< JointFrame >::const_iterator it = mFrames.begin(); it != mFrames.end(); ++it )
+		newest = std::max( newest, it->time );
+
+	mFused.clear();
+	splitBindings( newest - maxAge );
+
+	// the bound users go first, so the new users are matched against the users of all sensors
+	for ( int pass = 0; pass < 2; pass++ )
+	{
+		for ( int sensor = 0; sensor < getSensorCount(); sensor++ )
+		{
+			const JointFrame &sensorFrame = mFrames[ sensor ];
+			if ( sensorFrame.time < newest - maxAge )
+				continue;
+
+			// joints of a user are consecutive
+			vector< JointFrame::Joint >::const_iterator userEnd;
+			for ( vector< JointFrame::Joint >::const_iterator it = sensorFrame.joints.begin(); it != sensorFrame.joints.end(); it = userEnd )
+			{
+				userEnd = it;
+				while ( ( userEnd != sensorFrame.joints.end() ) && ( userEnd->userId == it->userId ) )
+					++userEnd;
+
+				const Binding *binding = findBinding( sensor, it->userId );
+				if ( pass == 0 )
+				{
+					if ( binding )
+						accumulate( getFusedUser( binding->fusedId ), it, userEnd );
+					continue;
+				}
+				if ( binding )
+					continue;
+
+				// a user is bound when its torso is tracked
+				vector< JointFrame::Joint >::const_iterator torso = findTorso( it, userEnd );
+				if ( torso == userEnd )
+					continue;
+
+				FusedUser *user = findNearest( sensor, torso->pos );
+				if ( ! user )
+				{
+					user = &getFusedUser( mNextId );
+					events->push_back( SkeletonSource::Event( SkeletonSource::USER_NEW, mNextId ) );
+					// joint streams store 16-bit user ids
+					mNextId = ( mNextId % 0xffff ) + 1;
+				}
+
+				Binding newBinding = { sensor, it->userId, user->id };
+				mBindings.push_back( newBinding );
+				accumulate( *user, it, userEnd );
+			}
+		}
+	}
+
+	frame->time = newest;
+	frame->joints.clear();
+	for ( vector< FusedUser >::const_iterator it = mFused.begin(); it != mFused.end(); ++it )
+	{
+		for ( int i = 0; i < JointTable::sCount; i++ )
+		{
+			Vec2f pos = ( it->weight[ i ] > 0.f ) ? it->sum[ i ] / it->weight[ i ] : Vec2f::zero();
+			frame->joints.push_back( JointFrame::Joint( it->id, JointTable::sJoints[ i ].id, pos, it->confidence[ i ] ) );
+		}
+	}
+}
+
+void SensorFusion::splitBindings( double oldest )
+{
+	// torso of each binding in the current frames
+	mTorsos.assign( mBindings.size(), Vec2f::zero() );
+	mTorsoValid.assign( mBindings.size(), 0 );
+	for ( int sensor = 0; sensor < getSensorCount(); sensor++ )
+	{
+		const JointFrame &sensorFrame = mFrames[ sensor ];
+		if ( sensorFrame.time < oldest )
+			continue;
+
+		vector< JointFrame::Joint >::const_iterator userEnd;
+		for ( vector< JointFrame::Joint >::const_iterator it = sensorFrame.joints.begin(); it != sensorFrame.joints.end(); it = userEnd )
+		{
+			userEnd = it;
+			while ( ( userEnd != sensorFrame.joints.end() ) && ( userEnd->userId == it->userId ) )
+				++userEnd;
+
+			const Binding *binding = findBinding( sensor, it->userId );
+			vector< JointFrame::Joint >::const_iterator torso = findTorso( it, userEnd );
+			if ( ! binding || ( torso == userEnd ) )
+				continue;
+
+			size_t index = binding - &mBindings[ 0 ];
+			mTorsos[ index ] = torso->pos;
+			mTorsoValid[ index ] = 1;
+		}
+	}
+
+	// the oldest binding of a fused user with a tracked torso anchors it, the users of the other
+	// sensors which moved too far from it are unbound and matched again as new users
+	for ( size_t i = mBindings.size(); i-- > 0; )
+	{
+		if ( ! mTorsoValid[ i ] )
+			continue;
+
+		for ( size_t j = 0; j < i; j++ )
+		{
+			if ( mTorsoValid[ j ] && ( mBindings[ j ].fusedId == mBindings[ i ].fusedId ) )
+			{
+				if ( mTorsos[ i ].distance( mTorsos[ j ] ) > mDistance )
+					mBindings.erase( mBindings.begin() + i );
+				break;
+			}
+		}
+	}
+}
+
+vector< JointFrame::Joint >::const_iterator SensorFusion::findTorso( vector< JointFrame::Joint >::const_iterator begin,
+																	 vector< JointFrame::Joint >::const_iterator end )
+{
+	vector< JointFrame::Joint >::const_iterator torso = begin;
+	while ( ( torso != end ) && ( ( torso->jointId != XN_SKEL_TORSO ) || ( torso->confidence <= 0.f ) ) )
+		++torso;
+	return torso;
+}
+
+const SensorFusion::Binding *SensorFusion::findBinding( int sensor, unsigned userId ) const
+{
+	for ( vector< Binding >::const_iterator it = mBindings.begin(); it != mBindings.end(); ++it )
+	{
+		if ( ( it->sensor == sensor ) && ( it->userId == userId ) )
+			return &*it;
+	}
+	return NULL;
+}
+
+bool SensorFusion::isBound( int sensor, unsigned fusedId ) const
+{
+	for ( vector< Binding >::const_iterator it = mBindings.begin(); it != mBindings.end(); ++it )
+	{
+		if ( ( it->sensor == sensor ) && ( it->fusedId == fusedId ) )
+			return true;
+	}
+	return false;
+}
+
+SensorFusion::FusedUser &SensorFusion::getFusedUser( unsigned fusedId )
+{
+	for ( vector< FusedUser >::iterator it = mFused.begin(); it != mFused.end(); ++it )
+	{
+		if ( it->id == fusedId )
+			return *it;
+	}
+
+	FusedUser user;
+	user.id = fusedId;
+	std::fill( user.sum, user.sum + JointTable::sCount, Vec2f::zero() );
+	std::fill( user.weight, user.weight + JointTable::sCount, 0.f );
+	std::fill( user.confidence, user.confidence + JointTable::sCount, 0.f );
+	mFused.push_back( user );
+	return mFused.back();
+}
+
+SensorFusion::FusedUser *SensorFusion::findNearest( int sensor, Vec2f torso )
+{
+	int torsoSlot = JointTable::getSlot( XN_SKEL_TORSO );
+	FusedUser *nearest = NULL;
+	float nearestDistance = mDistance;
+	for ( vector< FusedUser >::iterator it = mFused.begin(); it != mFused.end(); ++it )
+	{
+		// two users of the same sensor are never the same performer
+		if ( ( it->weight[ torsoSlot ] <= 0.f ) || isBound( sensor, it->id ) )
+			continue;
+
+		float distance = torso.distance( it->sum[ torsoSlot ] / it->weight[ torsoSlot ] );
+		if ( distance < nearestDistance )
+		{
+			nearest = &*it;
+			nearestDistance = distance;
+		}
+	}
+	return nearest;
+}
+
+void SensorFusion::accumulate( FusedUser &user, vector< JointFrame::Joint >::const_iterator begin,
+							   vector< JointFrame::Joint >::const_iterator end )
+{
+	for ( vector< JointFrame::Joint >::const_iterator it = begin; it != end; ++it )
+	{
+		int slot = JointTable::getSlot( XnSkeletonJoint( it->jointId ) );
+		if ( ( slot < 0 ) || ( it->confidence <= 0.f ) )
+			continue;
+
+		user.sum[ slot ] += it->confidence * it->pos;
+		user.weight[ slot ] += it->confidence;
+		user.confidence[ slot ] = std::max( user.confidence[ slot ], it->confidence );
+	}
+}
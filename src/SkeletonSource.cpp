@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <limits>
+
+#include "cinder/app/App.h"
+
+#include "OpenNISource.h"
+#include "SkeletonSource.h"
+#include "SyntheticSource.h"
+
+using namespace std;
+using namespace ci;
+
+const char *SkeletonSource::sTypeNames[ SkeletonSource::SOURCE_COUNT ] = { "Device", "Recording", "Joint stream", "Synthetic" };
+
+SkeletonSourceRef SkeletonSource::create( Type type, const fs::path &path /* = "" */, int device /* = 0 */ )
+{
+	switch ( type )
+	{
+		case SOURCE_DEVICE:
+			return SkeletonSourceRef( new OpenNISource( "", device ) );
+
+		case SOURCE_RECORDING:
+			return SkeletonSourceRef( new OpenNISource( path ) );
+
+		case SOURCE_JOINT_STREAM:
+			return SkeletonSourceRef( new JointStreamSource( path ) );
+
+		case SOURCE_SYNTHETIC:
+		default:
+			return SkeletonSourceRef( new SyntheticSource() );
+	}
+}
+
+JointStreamSource::JointStreamSource( const fs::path &path )
+: mPath( path )
+, mStartTime( 0.0 )
+, mRewound( false )
+{
+}
+
+bool JointStreamSource::open()
+{
+	try
+	{
+		if ( ! rewind() )
+		{
+			mStatus = "Joint stream empty";
+			return false;
+		}
+	}
+	catch ( const JointStreamExc & )
+	{
+		mStatus = "Joint stream not found";
+		return false;
+	}
+
+	mStatus = "Joint stream loaded";
+	return true;
+}
+
+bool JointStreamSource::rewind()
+{
+	mReader = std::shared_ptr< JointStreamReader >( new JointStreamReader( mPath ) );
+	mStartTime = app::getElapsedSeconds();
+	return mReader->read( &mNextFrame );
+}
+
+bool JointStreamSource::read( JointFrame *frame, vector< Event > *events )
+{
+	// the next pass starts with new users, so the filter does not jump across the loop
+	if ( mRewound )
+	{
+		for ( vector< unsigned >::const_iterator it = mUsers.begin(); it != mUsers.end(); ++it )
+			events->push_back( Event( USER_LOST, *it ) );
+		mUsers.clear();
+		mRewound = false;
+	}
+
+	if ( app::getElapsedSeconds() < mStartTime + mNextFrame.time )
+		return false;
+
+	// users come and go with their joints, joints of a user are consecutive
+	mFrameUsers.clear();
+	for ( vector< JointFrame::Joint >::const_iterator it = mNextFrame.joints.begin(); it != mNextFrame.joints.end(); ++it )
+	{
+		if ( mFrameUsers.empty() || ( mFrameUsers.back() != it->userId ) )
+			mFrameUsers.push_back( it->userId );
+	}
+	for ( vector< unsigned >::const_iterator it = mUsers.begin(); it != mUsers.end(); ++it )
+	{
+		if ( std::find( mFrameUsers.begin(), mFrameUsers.end(), *it ) == mFrameUsers.end() )
+			events->push_back( Event( USER_LOST, *it ) );
+	}
+	for ( vector< unsigned >::const_iterator it = mFrameUsers.begin(); it != mFrameUsers.end(); ++it )
+	{
+		if ( std::find( mUsers.begin(), mUsers.end(), *it ) == mUsers.end() )
+			events->push_back( Event( USER_NEW, *it ) );
+	}
+	mUsers.swap( mFrameUsers );
+
+	frame->time = mStartTime + mNextFrame.time;
+	frame->joints.assign( mNextFrame.joints.begin(), mNextFrame.joints.end() );
+
+	if ( ! mReader->read( &mNextFrame ) )
+	{
+		mRewound = true;
+		try
+		{
+			if ( ! rewind() )
+				mNextFrame.time = numeric_limits< double >::max();
+		}
+		catch ( const JointStreamExc & )
+		{
+			// the stream has been removed meanwhile, its users are lost and no frames follow
+			mNextFrame.time = numeric_limits< double >::max();
+		}
+	}
+
+	return true;
+}
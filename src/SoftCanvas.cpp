@@ -0,0 +1,434 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "cinder/CinderMath.h"
+
+#include "Canvas.h"
+#include "SoftCanvas.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) )
+#define SOFT_CANVAS_SSE 1
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+using namespace ci;
+
+namespace {
+
+// rgba pixel operations, one vector per pixel
+#if SOFT_CANVAS_SSE
+typedef __m128 Rgba;
+
+inline Rgba load( const float *p ) { return _mm_loadu_ps( p ); }
+inline void store( float *p, Rgba c ) { _mm_storeu_ps( p, c ); }
+inline Rgba splat( float f ) { return _mm_set1_ps( f ); }
+inline Rgba add( Rgba a, Rgba b ) { return _mm_add_ps( a, b ); }
+inline Rgba sub( Rgba a, Rgba b ) { return _mm_sub_ps( a, b ); }
+inline Rgba mul( Rgba a, Rgba b ) { return _mm_mul_ps( a, b ); }
+inline Rgba vmin( Rgba a, Rgba b ) { return _mm_min_ps( a, b ); }
+inline Rgba vmax( Rgba a, Rgba b ) { return _mm_max_ps( a, b ); }
+inline Rgba alpha( Rgba c ) { return _mm_shuffle_ps( c, c, _MM_SHUFFLE( 3, 3, 3, 3 ) ); }
+//! Returns \a c with its alpha replaced by \a a.
+inline Rgba withAlpha( Rgba c, float a )
+{
+	const __m128 rgbMask = _mm_castsi128_ps( _mm_set_epi32( 0, -1, -1, -1 ) );
+	return _mm_or_ps( _mm_and_ps( rgbMask, c ), _mm_andnot_ps( rgbMask, _mm_set1_ps( a ) ) );
+}
+#else
+struct Rgba
+{
+	float v[ 4 ];
+};
+
+inline Rgba load( const float *p ) { Rgba c = { { p[ 0 ], p[ 1 ], p[ 2 ], p[ 3 ] } }; return c; }
+inline void store( float *p, Rgba c ) { p[ 0 ] = c.v[ 0 ]; p[ 1 ] = c.v[ 1 ]; p[ 2 ] = c.v[ 2 ]; p[ 3 ] = c.v[ 3 ]; }
+inline Rgba splat( float f ) { Rgba c = { { f, f, f, f } }; return c; }
+inline Rgba add( Rgba a, Rgba b ) { for ( int i = 0; i < 4; i++ ) a.v[ i ] += b.v[ i ]; return a; }
+inline Rgba sub( Rgba a, Rgba b ) { for ( int i = 0; i < 4; i++ ) a.v[ i ] -= b.v[ i ]; return a; }
+inline Rgba mul( Rgba a, Rgba b ) { for ( int i = 0; i < 4; i++ ) a.v[ i ] *= b.v[ i ]; return a; }
+inline Rgba vmin( Rgba a, Rgba b ) { for ( int i = 0; i < 4; i++ ) a.v[ i ] = std::min( a.v[ i ], b.v[ i ] ); return a; }
+inline Rgba vmax( Rgba a, Rgba b ) { for ( int i = 0; i < 4; i++ ) a.v[ i ] = std::max( a.v[ i ], b.v[ i ] ); return a; }
+inline Rgba alpha( Rgba c ) { return splat( c.v[ 3 ] ); }
+inline Rgba withAlpha( Rgba c, float a ) { c.v[ 3 ] = a; return c; }
+#endif
+
+inline Rgba lerp( Rgba a, Rgba b, float t )
+{
+	return add( a, mul( sub( b, a ), splat( t ) ) );
+}
+
+inline int wrap( int i, int size )
+{
+	i %= size;
+	return ( i < 0 ) ? i + size : i;
+}
+
+} // anonymous namespace
+
+const int SoftCanvas::sTileSize = 64;
+
+SoftCanvas::SoftCanvas()
+: mTileCountX( 0 )
+, mTileCountY( 0 )
+, mFadeout( 1.f )
+, mBlendmode( Canvas::BLENDMODE_DARKEN )
+, mFrame( 0 )
+, mNextTile( 0 )
+, mTilesDone( 0 )
+, mQuit( false )
+{
+}
+
+SoftCanvas::~SoftCanvas()
+{
+	stopThreads();
+}
+
+void SoftCanvas::setup( int width, int height, size_t threadCount /* = 0 */ )
+{
+	stopThreads();
+
+	mSize = Vec2i( width, height );
+	mCanvas.resize( width * height * 4 );
+	clear();
+
+	mTileCountX = ( width + sTileSize - 1 ) / sTileSize;
+	mTileCountY = ( height + sTileSize - 1 ) / sTileSize;
+	mBins.assign( mTileCountX * mTileCountY, vector< uint32_t >() );
+	mStrokes.resize( sTileSize * sTileSize * 4 );
+
+	if ( threadCount == 0 )
+		threadCount = std::max< size_t >( thread::hardware_concurrency(), 1 );
+
+	// the drawing thread renders tiles as well
+	for ( size_t i = 1; i < threadCount; i++ )
+		mThreads.push_back( std::shared_ptr< thread >( new thread( bind( &SoftCanvas::workerThread, this ) ) ) );
+}
+
+void SoftCanvas::stopThreads()
+{
+	{
+		lock_guard< mutex > lock( mMutex );
+		mQuit = true;
+	}
+	mStartCond.notify_all();
+
+	for ( size_t i = 0; i < mThreads.size(); i++ )
+		mThreads[ i ]->join();
+	mThreads.clear();
+
+	mQuit = false;
+}
+
+void SoftCanvas::setBrushes( const BrushArray &brushes )
+{
+	mBrushes.resize( brushes.getCount() );
+	for ( size_t i = 0; i < mBrushes.size(); i++ )
+	{
+		const Surface8u &surface = brushes.getSurface( i );
+		Brush &brush = mBrushes[ i ];
+		brush.width = surface.getWidth();
+		brush.height = surface.getHeight();
+		brush.texels.resize( brush.width * brush.height * 4 );
+
+		float *out = &brush.texels[ 0 ];
+		for ( int y = 0; y < brush.height; y++ )
+		{
+			const uint8_t *in = surface.getData( Vec2i( 0, y ) );
+			for ( int x = 0; x < brush.width; x++, in += surface.getPixelInc(), out += 4 )
+			{
+				out[ 0 ] = in[ surface.getRedOffset() ] / 255.f;
+				out[ 1 ] = in[ surface.getGreenOffset() ] / 255.f;
+				out[ 2 ] = in[ surface.getBlueOffset() ] / 255.f;
+				out[ 3 ] = in[ surface.getAlphaOffset() ] / 255.f;
+			}
+		}
+	}
+}
+
+void SoftCanvas::clear()
+{
+	std::fill( mCanvas.begin(), mCanvas.end(), 1.f );
+}
+
+void SoftCanvas::draw( UserManager &userManager, float fadeout, int blendmode )
+{
+	if ( mBrushes.empty() )
+		setBrushes( userManager.getBrushes() );
+
+	draw( userManager.getStrokeBatch(), fadeout, blendmode );
+}
+
+void SoftCanvas::draw( const StrokeBatch &batch, float fadeout, int blendmode )
+{
+	if ( mCanvas.empty() )
+		return;
+
+	// set up and bin the triangles in drawing order
+	batch.getTriangles( &mVertices );
+	mTriangles.clear();
+	for ( size_t i = 0; i < mBins.size(); i++ )
+		mBins[ i ].clear();
+	for ( size_t i = 0; i + 2 < mVertices.size(); i += 3 )
+		addTriangle( &mVertices[ i ] );
+
+	mFadeout = fadeout;
+	mBlendmode = blendmode;
+
+	{
+		lock_guard< mutex > lock( mMutex );
+		mNextTile = 0;
+		mTilesDone = 0;
+		mFrame++;
+	}
+	mStartCond.notify_all();
+
+	renderTiles( &mStrokes[ 0 ] );
+
+	unique_lock< mutex > lock( mMutex );
+	while ( mTilesDone < mBins.size() )
+		mDoneCond.wait( lock );
+}
+
+void SoftCanvas::addTriangle( const StrokeBatch::RibbonVertex *vertices )
+{
+	if ( mBrushes.empty() )
+		return;
+
+	const StrokeBatch::RibbonVertex *v[ 3 ] = { &vertices[ 0 ], &vertices[ 1 ], &vertices[ 2 ] };
+
+	// counterclockwise in the y up pixel coordinates
+	float area = ( v[ 1 ]->pos - v[ 0 ]->pos ).cross( v[ 2 ]->pos - v[ 0 ]->pos );
+	if ( area < 0.f )
+	{
+		std::swap( v[ 1 ], v[ 2 ] );
+		area = -area;
+	}
+	if ( ! ( area > 0.f ) )
+		return;
+
+	Triangle triangle;
+	for ( int i = 0; i < 3; i++ )
+	{
+		// edge opposite to vertex i, positive inside
+		const Vec2f &a = v[ ( i + 1 ) % 3 ]->pos;
+		const Vec2f &b = v[ ( i + 2 ) % 3 ]->pos;
+		float dx = b.x - a.x;
+		float dy = b.y - a.y;
+		triangle.edge[ i ][ 0 ] = -dy;
+		triangle.edge[ i ][ 1 ] = dx;
+		triangle.edge[ i ][ 2 ] = dy * a.x - dx * a.y;
+		// an edge shared by two triangles is covered by exactly one of them
+		triangle.topLeft[ i ] = ( dy < 0.f ) || ( ( dy == 0.f ) && ( dx < 0.f ) );
+	}
+
+	// the texture coordinates are the barycentric sums of the vertex coordinates
+	for ( int c = 0; c < 3; c++ )
+	{
+		triangle.u[ c ] = ( triangle.edge[ 0 ][ c ] * v[ 0 ]->uvl.x +
+							triangle.edge[ 1 ][ c ] * v[ 1 ]->uvl.x +
+							triangle.edge[ 2 ][ c ] * v[ 2 ]->uvl.x ) / area;
+		triangle.v[ c ] = ( triangle.edge[ 0 ][ c ] * v[ 0 ]->uvl.y +
+							triangle.edge[ 1 ][ c ] * v[ 1 ]->uvl.y +
+							triangle.edge[ 2 ][ c ] * v[ 2 ]->uvl.y ) / area;
+	}
+
+	// array layers are selected like in gl
+	triangle.layer = math< int >::clamp( int( math< float >::floor( v[ 0 ]->uvl.z + .5f ) ),
+										 0, int( mBrushes.size() ) - 1 );
+
+	float minX = std::min( std::min( v[ 0 ]->pos.x, v[ 1 ]->pos.x ), v[ 2 ]->pos.x );
+	float maxX = std::max( std::max( v[ 0 ]->pos.x, v[ 1 ]->pos.x ), v[ 2 ]->pos.x );
+	float minY = std::min( std::min( v[ 0 ]->pos.y, v[ 1 ]->pos.y ), v[ 2 ]->pos.y );
+	float maxY = std::max( std::max( v[ 0 ]->pos.y, v[ 1 ]->pos.y ), v[ 2 ]->pos.y );
+	triangle.x0 = std::max( int( math< float >::floor( minX ) ), 0 );
+	triangle.y0 = std::max( int( math< float >::floor( minY ) ), 0 );
+	triangle.x1 = std::min( int( math< float >::ceil( maxX ) ), mSize.x );
+	triangle.y1 = std::min( int( math< float >::ceil( maxY ) ), mSize.y );
+	if ( ( triangle.x0 >= triangle.x1 ) || ( triangle.y0 >= triangle.y1 ) )
+		return;
+
+	uint32_t id = uint32_t( mTriangles.size() );
+	mTriangles.push_back( triangle );
+
+	for ( int ty = triangle.y0 / sTileSize; ty <= ( triangle.y1 - 1 ) / sTileSize; ty++ )
+		for ( int tx = triangle.x0 / sTileSize; tx <= ( triangle.x1 - 1 ) / sTileSize; tx++ )
+			mBins[ ty * mTileCountX + tx ].push_back( id );
+}
+
+void SoftCanvas::workerThread()
+{
+	vector< float > strokes( sTileSize * sTileSize * 4 );
+	unsigned frame = 0;
+
+	while ( true )
+	{
+		{
+			unique_lock< mutex > lock( mMutex );
+			while ( ( frame == mFrame ) && ! mQuit )
+				mStartCond.wait( lock );
+			if ( mQuit )
+				return;
+			frame = mFrame;
+		}
+
+		renderTiles( &strokes[ 0 ] );
+	}
+}
+
+void SoftCanvas::renderTiles( float *strokes )
+{
+	while ( true )
+	{
+		size_t tile;
+		{
+			lock_guard< mutex > lock( mMutex );
+			if ( mNextTile >= mBins.size() )
+				return;
+			tile = mNextTile++;
+		}
+
+		renderTile( tile, strokes );
+
+		bool done;
+		{
+			lock_guard< mutex > lock( mMutex );
+			done = ( ++mTilesDone == mBins.size() );
+		}
+		if ( done )
+			mDoneCond.notify_all();
+	}
+}
+
+void SoftCanvas::renderTile( size_t tile, float *strokes )
+{
+	int tileX = int( tile % mTileCountX ) * sTileSize;
+	int tileY = int( tile / mTileCountX ) * sTileSize;
+	int width = std::min( sTileSize, mSize.x - tileX );
+	int height = std::min( sTileSize, mSize.y - tileY );
+
+	// stroke layer, cleared like fbo attachment 0
+	float clearColor = ( mBlendmode == Canvas::BLENDMODE_DARKEN ) ? 1.f : 0.f;
+	std::fill( strokes, strokes + sTileSize * height * 4, clearColor );
+
+	const vector< uint32_t > &bin = mBins[ tile ];
+	for ( vector< uint32_t >::const_iterator it = bin.begin(); it != bin.end(); ++it )
+	{
+		const Triangle &triangle = mTriangles[ *it ];
+		rasterize( triangle,
+				   std::max( triangle.x0, tileX ), std::max( triangle.y0, tileY ),
+				   std::min( triangle.x1, tileX + width ), std::min( triangle.y1, tileY + height ),
+				   tileX, tileY, strokes );
+	}
+
+	// blend the strokes with the faded canvas like Stroke.frag
+	const Rgba fadeWhite = splat( 1.f - mFadeout );
+	const Rgba fadeout = splat( mFadeout );
+	for ( int y = 0; y < height; y++ )
+	{
+		const float *s = strokes + y * sTileSize * 4;
+		float *d = &mCanvas[ ( ( tileY + y ) * mSize.x + tileX ) * 4 ];
+		for ( int x = 0; x < width; x++, s += 4, d += 4 )
+		{
+			Rgba c = load( s );
+			Rgba bc = load( d );
+
+			// premultiply color
+			c = mul( c, withAlpha( alpha( c ), 1.f ) );
+			bc = mul( bc, withAlpha( alpha( bc ), 1.f ) );
+
+			Rgba blend;
+			if ( mBlendmode == Canvas::BLENDMODE_DARKEN )
+				blend = vmin( bc, c );
+			else
+				blend = vmax( bc, alpha( c ) );
+
+			store( d, withAlpha( add( fadeWhite, mul( blend, fadeout ) ), 1.f ) );
+		}
+	}
+}
+
+void SoftCanvas::rasterize( const Triangle &triangle, int x0, int y0, int x1, int y1,
+							int tileX, int tileY, float *strokes )
+{
+	const Brush &brush = mBrushes[ triangle.layer ];
+	const float *texels = &brush.texels[ 0 ];
+	const int rowFloats = brush.width * 4;
+
+	for ( int y = y0; y < y1; y++ )
+	{
+		float py = y + .5f;
+		float *out = strokes + ( ( y - tileY ) * sTileSize + ( x0 - tileX ) ) * 4;
+
+		for ( int x = x0; x < x1; x++, out += 4 )
+		{
+			float px = x + .5f;
+
+			// pixel center coverage
+			bool inside = true;
+			for ( int i = 0; inside && ( i < 3 ); i++ )
+			{
+				float e = triangle.edge[ i ][ 0 ] * px + triangle.edge[ i ][ 1 ] * py + triangle.edge[ i ][ 2 ];
+				inside = ( e > 0.f ) || ( ( e == 0.f ) && triangle.topLeft[ i ] );
+			}
+			if ( ! inside )
+				continue;
+
+			// bilinear sample with repeat wrapping
+			float s = ( triangle.u[ 0 ] * px + triangle.u[ 1 ] * py + triangle.u[ 2 ] ) * brush.width - .5f;
+			float t = ( triangle.v[ 0 ] * px + triangle.v[ 1 ] * py + triangle.v[ 2 ] ) * brush.height - .5f;
+			float sf = math< float >::floor( s );
+			float tf = math< float >::floor( t );
+			int s0 = wrap( int( sf ), brush.width );
+			int t0 = wrap( int( tf ), brush.height );
+			int s1 = ( s0 + 1 == brush.width ) ? 0 : s0 + 1;
+			int t1 = ( t0 + 1 == brush.height ) ? 0 : t0 + 1;
+
+			const float *row0 = texels + t0 * rowFloats;
+			const float *row1 = texels + t1 * rowFloats;
+			Rgba c0 = lerp( load( row0 + s0 * 4 ), load( row0 + s1 * 4 ), s - sf );
+			Rgba c1 = lerp( load( row1 + s0 * 4 ), load( row1 + s1 * 4 ), s - sf );
+			Rgba src = lerp( c0, c1, t - tf );
+
+			// alpha blending
+			Rgba a = alpha( src );
+			store( out, add( mul( src, a ), mul( load( out ), sub( splat( 1.f ), a ) ) ) );
+		}
+	}
+}
+
+Surface32f SoftCanvas::getSurface() const
+{
+	Surface32f surface( mSize.x, mSize.y, true, SurfaceChannelOrder::RGBA );
+
+	for ( int y = 0; y < mSize.y; y++ )
+	{
+		const float *in = &mCanvas[ ( mSize.y - 1 - y ) * mSize.x * 4 ];
+		std::copy( in, in + mSize.x * 4, surface.getData( Vec2i( 0, y ) ) );
+	}
+
+	return surface;
+}
+
+float SoftCanvas::getMaxDifference( const Surface32f &a, const Surface32f &b )
+{
+	if ( a.getSize() != b.getSize() )
+		return numeric_limits< float >::max();
+
+	float difference = 0.f;
+	for ( int y = 0; y < a.getHeight(); y++ )
+	{
+		const float *pa = a.getData( Vec2i( 0, y ) );
+		const float *pb = b.getData( Vec2i( 0, y ) );
+		for ( int x = 0; x < a.getWidth(); x++, pa += a.getPixelInc(), pb += b.getPixelInc() )
+		{
+			difference = std::max( difference, math< float >::abs( pa[ a.getRedOffset() ] - pb[ b.getRedOffset() ] ) );
+			difference = std::max( difference, math< float >::abs( pa[ a.getGreenOffset() ] - pb[ b.getGreenOffset() ] ) );
+			difference = std::max( difference, math< float >::abs( pa[ a.getBlueOffset() ] - pb[ b.getBlueOffset() ] ) );
+		}
+	}
+
+	return difference;
+}
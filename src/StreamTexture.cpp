@@ -0,0 +1,151 @@
+#include <cstring>
+
+#include "StreamTexture.h"
+
+using namespace std;
+using namespace ci;
+
+StreamTexture::StreamTexture()
+: mImageSize( Vec2i::zero() )
+, mFrame( 0 )
+{
+}
+
+bool StreamTexture::write( const Surface8u &surface )
+{
+	Vec2i size = surface.getSize();
+	Buffer *buffer = NULL;
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		mImageSize = size;
+		for ( int i = 0; i < sBufferCount && ! buffer; i++ )
+		{
+			if ( ( mBuffers[ i ].state == Buffer::MAPPED ) && ( mBuffers[ i ].size == size ) )
+				buffer = &mBuffers[ i ];
+		}
+		// the gl thread maps buffers of the new size on the next update
+		if ( ! buffer )
+			return false;
+		buffer->state = Buffer::WRITING;
+	}
+
+	// tightly packed rgb rows, the top row first like gl::Texture( Surface )
+	size_t rowSize = size.x * 3;
+	uint8_t inc = surface.getPixelInc();
+	uint8_t red = surface.getRedOffset();
+	uint8_t green = surface.getGreenOffset();
+	uint8_t blue = surface.getBlueOffset();
+	bool packed = ( inc == 3 ) && ( red == 0 ) && ( green == 1 ) && ( blue == 2 );
+	uint8_t *dst = buffer->data;
+	for ( int32_t y = 0; y < size.y; y++ )
+	{
+		const uint8_t *src = surface.getData() + y * surface.getRowBytes();
+		if ( packed )
+		{
+			memcpy( dst, src, rowSize );
+		}
+		else
+		{
+			for ( int32_t x = 0; x < size.x; x++, src += inc )
+			{
+				dst[ x * 3 ] = src[ red ];
+				dst[ x * 3 + 1 ] = src[ green ];
+				dst[ x * 3 + 2 ] = src[ blue ];
+			}
+		}
+		dst += rowSize;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		buffer->frame = ++mFrame;
+		buffer->state = Buffer::FILLED;
+	}
+	return true;
+}
+
+void StreamTexture::update()
+{
+	Buffer *upload = NULL;
+	Vec2i imageSize;
+	bool remap[ sBufferCount ];
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		imageSize = mImageSize;
+
+		// only the newest image is uploaded, the buffers of the older ones are given back mapped
+		for ( int i = 0; i < sBufferCount; i++ )
+		{
+			Buffer &buffer = mBuffers[ i ];
+			if ( buffer.state != Buffer::FILLED )
+				continue;
+			if ( upload && ( upload->frame > buffer.frame ) )
+			{
+				buffer.state = Buffer::MAPPED;
+				continue;
+			}
+			if ( upload )
+				upload->state = Buffer::MAPPED;
+			upload = &buffer;
+		}
+		if ( upload )
+			upload->state = Buffer::FREE;
+
+		// buffers mapped for an old image size are allocated again
+		for ( int i = 0; i < sBufferCount; i++ )
+		{
+			Buffer &buffer = mBuffers[ i ];
+			if ( ( buffer.state == Buffer::MAPPED ) && ( buffer.size != imageSize ) )
+				buffer.state = Buffer::FREE;
+			remap[ i ] = ( buffer.state == Buffer::FREE ) && ( &buffer != upload );
+		}
+	}
+
+	if ( upload )
+	{
+		upload->pbo.unmap();
+		upload->data = NULL;
+
+		Vec2i size = upload->size;
+		if ( ! mTexture || ( mTexture.getWidth() != size.x ) || ( mTexture.getHeight() != size.y ) )
+		{
+			gl::Texture::Format format;
+			format.setInternalFormat( GL_RGB );
+			mTexture = gl::Texture( size.x, size.y, format );
+		}
+
+		// the pixels are read from the bound buffer, the call returns before the transfer is done
+		mTexture.bind();
+		upload->pbo.bind();
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 1 );
+		glTexSubImage2D( mTexture.getTarget(), 0, 0, 0, size.x, size.y, GL_RGB, GL_UNSIGNED_BYTE, (const GLvoid *)0 );
+		glPixelStorei( GL_UNPACK_ALIGNMENT, 4 );
+		upload->pbo.unbind();
+		mTexture.unbind();
+
+		// mapped again on the next update, when the transfer has had time to finish
+	}
+
+	if ( ( imageSize.x <= 0 ) || ( imageSize.y <= 0 ) )
+		return;
+
+	for ( int i = 0; i < sBufferCount; i++ )
+	{
+		if ( ! remap[ i ] )
+			continue;
+
+		// the storage is orphaned, so mapping does not wait for an upload still reading it
+		Buffer &buffer = mBuffers[ i ];
+		if ( ! buffer.pbo )
+			buffer.pbo = gl::Vbo( GL_PIXEL_UNPACK_BUFFER );
+		if ( buffer.data )
+			buffer.pbo.unmap();
+		buffer.pbo.bufferData( imageSize.x * imageSize.y * 3, NULL, GL_STREAM_DRAW );
+		buffer.data = buffer.pbo.map( GL_WRITE_ONLY );
+		buffer.pbo.unbind();
+		buffer.size = imageSize;
+
+		std::lock_guard< std::mutex > lock( mMutex );
+		buffer.state = buffer.data ? Buffer::MAPPED : Buffer::FREE;
+	}
+}
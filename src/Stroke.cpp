@@ -8,7 +8,9 @@ using namespace std;
 using namespace ci;
 using namespace ci::app;
 
-Stroke::Stroke()
+const size_t Stroke::sMaxSegments = 1024;
+
+Stroke::Stroke( StrokeSimulation *simulation /* = NULL */ )
 : mActive( true )
 , mK( 0.06f )
 , mDamping( 0.7f )
@@ -17,7 +19,62 @@ Stroke::Stroke()
 , mStrokeMaxWidth( 160.0f )
 , mMaxVelocity( 40.0f )
 , mEmpty( true )
+, mLastDrawn( 0 )
+, mBrush( -1 )
+, mSimulation( simulation )
+, mSlot( 0 )
+, mBatched( false )
+, mEmitted( false )
+, mTargetTime( -1.0 )
+, mEmitTime( -1.0 )
+, mHeadValid( false )
+, mRecorder( NULL )
+, mUserId( 0 )
+, mJointId( 0 )
+{
+	if ( mSimulation )
+		mSlot = mSimulation->allocate();
+}
+
+Stroke::~Stroke()
+{
+	release();
+}
+
+void Stroke::reset( StrokeSimulation *simulation )
+{
+	release();
+
+	mActive    = true;
+	mEmpty     = true;
+	mPos       = Vec2f::zero();
+	mTarget    = Vec2f::zero();
+	mVel       = Vec2f::zero();
+	mU         = 0.f;
+	mLastDrawn = 0;
+	mBrush     = -1;
+	mBatched   = false;
+	mEmitted   = false;
+	mTargetTime = -1.0;
+	mEmitTime  = -1.0;
+	mHeadValid = false;
+	mPoints.clear();
+	mEmitter.reset();
+
+	mSimulation = simulation;
+	if ( mSimulation )
+		mSlot = mSimulation->allocate();
+}
+
+void Stroke::release()
 {
+	if ( mRecorder )
+		mRecorder->endStroke( mUserId, mJointId );
+	mRecorder = NULL;
+
+	if ( mSimulation )
+		mSimulation->release( mSlot );
+	mSimulation = NULL;
 }
 
 void Stroke::resize( const ci::Vec2i &size )
@@ -25,10 +82,14 @@ void Stroke::resize( const ci::Vec2i &size )
 	mWindowSize = size;
 }
 
-void Stroke::addPos( Vec2f pos )
+void Stroke::addPos( Vec2f pos, double time )
 {
 	mTarget = pos;
+	mTargetTime = time;
 	mEmpty  = false;
+
+	if ( mSimulation )
+		mSimulation->setTarget( mSlot, pos );
 }
 
 void Stroke::update()
@@ -43,13 +104,27 @@ void Stroke::update()
 		mVel = Vec2f::zero();
 		mU = 0.f;
 		mLastDrawn = 0;
+		mEmitted = false;
+	}
+
+	// the spring has been stepped by the simulation already
+	if ( mBatched )
+	{
+		if ( mSimulation->isEmitted( mSlot ) )
+			emit( mSimulation->getPoint( mSlot ) );
+		else
+			flush();
+		return;
 	}
 
 	Vec2f d = mPos - mTarget; // displacement from the target
 
 	// no new point if the target is close
 	if ( ( d.lengthSquared() < .001f ) && ( !mPoints.empty() ) )
+	{
+		flush();
 		return;
+	}
 
 	Vec2f f = -mK * d; // Hooke's law F = - k * d
 	Vec2f a = f / mMass; // acceleration, F = ma
@@ -65,53 +140,131 @@ void Stroke::update()
 	Vec2f scaledVel = mVel * Vec2f( mWindowSize );
 	float s = math<float>::clamp( scaledVel.length(), 0, mMaxVelocity );
 	ang *= mStrokeMinWidth + ( mStrokeMaxWidth - mStrokeMinWidth ) * easeInQuad( s / mMaxVelocity );
-	mPoints.push_back( StrokePoint( mPos * Vec2f( mWindowSize ), ang, mU ) );
+	emit( StrokePoint( mPos * Vec2f( mWindowSize ), ang, mU ) );
 }
 
-void Stroke::draw( const Calibrate &calibrate, const Vec2f &posRef )
+void Stroke::emit( const StrokePoint &sample )
 {
-	if( ! mActive
-	 || ! mBrush )
+	size_t count = mPoints.size();
+	mEmitter.add( sample, mPoints );
+	if ( mPoints.size() != count )
+	{
+		mEmitted = true;
+		mEmitTime = mTargetTime;
+		record( count );
+	}
+}
+
+void Stroke::flush()
+{
+	size_t count = mPoints.size();
+	mEmitter.flush( mPoints );
+	if ( mPoints.size() != count )
+	{
+		mEmitted = true;
+		mEmitTime = mTargetTime;
+		record( count );
+	}
+}
+
+void Stroke::record( size_t first )
+{
+	if ( ! mRecorder )
 		return;
 
-	gl::enable( GL_TEXTURE_2D );
-	mBrush.bind();
-	gl::color( ColorA::white() );
+	for ( size_t i = first; i < mPoints.size(); ++i )
+		mRecorder->addPoint( mUserId, mJointId, mBrush, mPoints[ i ] );
+}
+
+void Stroke::setRecorder( StrokeRecorder *recorder, unsigned userId, int jointId )
+{
+	mRecorder = recorder;
+	mUserId   = userId;
+	mJointId  = jointId;
+}
+
+void Stroke::buildGeometry( float alpha, StrokeBatch &batch )
+{
+	if( ! mActive
+	 || mBrush < 0 )
+		return;
 
-	// subdivison to overcome texturing artifacts
-	size_t subdivCount = 8;
-	float coeffStep = 2.f / subdivCount;
-	float coeff = -1.f;
+	// the newest segment is only built up to the spring position interpolated
+	// between the last two steps, the rest of it is built in the next frame
+	size_t count = mPoints.size();
+	mHeadValid = mEmitted && ( alpha < 1.f ) && ( count >= 2 ) && ( count - 2 >= mLastDrawn );
+	if ( mHeadValid )
+	{
+		StrokePoint p0 = mPoints[ count - 2 ];
+		StrokePoint p1 = mPoints[ count - 1 ];
+		mHead = StrokePoint( lerp( p0.p, p1.p, alpha ), lerp( p0.w, p1.w, alpha ), lerp( p0.u, p1.u, alpha ) );
+	}
 
-	for ( size_t i = 0; i < subdivCount; i++ )
+	if ( count >= 2 )
 	{
-		float c0 = coeff;
-		float c1 = coeff + coeffStep;
-		float v0 = c0 *.5f + .5f;
-		float v1 = c1 *.5f + .5f;
-		if ( mPoints.size() >= 2 )
+		clampLastDrawn();
+
+		// add only the stroke segments not built already
+		if ( mLastDrawn + 1 < count )
 		{
-			glBegin( GL_QUAD_STRIP );
-			// add only the stroke points not drawn already
-			for( vector< StrokePoint >::const_iterator i = mPoints.begin() + mLastDrawn;
-					i != mPoints.end(); ++i )
-			{
-				const StrokePoint *s = &(*i);
-				glTexCoord2f( s->u, v0 );
-				gl::vertex( calibrate.transform( s->p + c0 * s->w, posRef ));
-				glTexCoord2f( s->u, v1 );
-				gl::vertex( calibrate.transform( s->p + c1 * s->w, posRef ));
-			}
-			glEnd();
+			batch.beginStroke( mBrush );
+			batch.addJointTime( mEmitTime );
+			for ( size_t i = mLastDrawn; i < count; ++i )
+				batch.addPoint( ( mHeadValid && ( i == count - 1 ) ) ? mHead : mPoints[ i ] );
 		}
-		coeff += coeffStep;
 	}
 
-	mBrush.unbind();
-	gl::disable( GL_TEXTURE_2D );
+	if ( mHeadValid )
+	{
+		mLastDrawn = count - 2;
+	}
+	else
+	{
+		if ( count > 0 )
+			mLastDrawn = count - 1;
+		mEmitted = false;
+	}
+}
+
+void Stroke::clampLastDrawn()
+{
+	// the segments built in one frame are limited, and points
+	// overwritten in the point buffer cannot be drawn anymore
+	if ( mPoints.size() - mLastDrawn > sMaxSegments )
+		mLastDrawn = mPoints.size() - sMaxSegments;
+	mLastDrawn = math< size_t >::max( mLastDrawn, mPoints.getFirst() );
+}
+
+void Stroke::clear()
+{
+	mPoints.clear();
+	mEmitter.reset();
+
+	if ( mRecorder )
+		mRecorder->endStroke( mUserId, mJointId );
+
+	if ( mSimulation )
+		mSimulation->reset( mSlot );
+}
+
+void Stroke::setBatched( bool batched )
+{
+	if ( ( batched == mBatched ) || ! mSimulation )
+		return;
+
+	// hand over the spring state
+	if ( batched )
+	{
+		mSimulation->setState( mSlot, mPos, mVel, mU, ! mPoints.empty() );
+	}
+	else
+	{
+		mPos = mSimulation->getPos( mSlot );
+		mVel = mSimulation->getVel( mSlot );
+		mU   = mSimulation->getU( mSlot );
+	}
 
-	if ( !mPoints.empty() )
-		mLastDrawn = mPoints.size() - 1;
+	mBatched = batched;
 }
 
 void Stroke::setActive( bool active )
@@ -120,6 +273,9 @@ void Stroke::setActive( bool active )
 	{
 		mActive = active;
 
+		if ( mSimulation )
+			mSimulation->setActive( mSlot, mActive );
+
 		if( ! mActive )
 			clear();
 	}
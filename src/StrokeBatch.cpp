@@ -0,0 +1,340 @@
+#include <cstddef>
+
+#include "cinder/app/App.h"
+#include "cinder/CinderMath.h"
+
+#include "Resources.h"
+#include "StrokeBatch.h"
+
+using namespace std;
+using namespace ci;
+using namespace ci::app;
+
+// subdivison to overcome texturing artifacts
+const size_t     StrokeBatch::sSubdivCount       = 8;
+const size_t     StrokeBatch::sRowCount          = StrokeBatch::sSubdivCount + 1;
+const size_t     StrokeBatch::sIndicesPerSegment = StrokeBatch::sSubdivCount * 6;
+// size of the transforms uniform array of StrokeBrush.vert and StrokeRibbon.vert
+const size_t     StrokeBatch::sMaxTransforms     = 16;
+gl::Vbo          StrokeBatch::sCornerVbo         = gl::Vbo();
+gl::GlslProg     StrokeBatch::sBrushShader       = gl::GlslProg();
+gl::GlslProg     StrokeBatch::sRibbonShader      = gl::GlslProg();
+
+StrokeBatch::StrokeBatch()
+: mGpuRibbon( false )
+, mLayer( 0.f )
+, mHasPoint( false )
+, mJointTime( -1.0 )
+, mBuildTime( -1.0 )
+{
+	setTransform( Matrix44f::identity() );
+}
+
+void StrokeBatch::setup()
+{
+	try
+	{
+		sBrushShader = gl::GlslProg( loadResource( RES_STROKE_BRUSH_VERT ),
+									 loadResource( RES_STROKE_RIBBON_FRAG ) );
+	}
+	catch ( const std::exception &exc )
+	{
+		console() << exc.what() << endl;
+	}
+
+	try
+	{
+		sRibbonShader = gl::GlslProg( loadResource( RES_STROKE_RIBBON_VERT ),
+									  loadResource( RES_STROKE_RIBBON_FRAG ) );
+	}
+	catch ( const std::exception &exc )
+	{
+		console() << exc.what() << endl;
+		return;
+	}
+
+	vector< Vec2f > corners = getCorners();
+	sCornerVbo = gl::Vbo( GL_ARRAY_BUFFER );
+	sCornerVbo.bufferData( corners.size() * sizeof( Vec2f ), &corners[ 0 ], GL_STATIC_DRAW );
+	sCornerVbo.unbind();
+}
+
+vector< Vec2f > StrokeBatch::getCorners()
+{
+	// same triangles as one segment of the cpu ribbon, corner x selects
+	// the segment end, corner y is the offset across the stroke width
+	vector< Vec2f > corners;
+	for ( size_t r = 0; r < sSubdivCount; r++ )
+	{
+		float c0 = -1.f + r * 2.f / sSubdivCount;
+		float c1 = -1.f + ( r + 1 ) * 2.f / sSubdivCount;
+		corners.push_back( Vec2f( 0.f, c0 ) );
+		corners.push_back( Vec2f( 0.f, c1 ) );
+		corners.push_back( Vec2f( 1.f, c0 ) );
+		corners.push_back( Vec2f( 0.f, c1 ) );
+		corners.push_back( Vec2f( 1.f, c1 ) );
+		corners.push_back( Vec2f( 1.f, c0 ) );
+	}
+	return corners;
+}
+
+void StrokeBatch::clear( bool gpuRibbon /* = false */ )
+{
+	mGpuRibbon = gpuRibbon && sRibbonShader;
+	mVertices.clear();
+	mIndices.clear();
+	mSegments.clear();
+	mTransforms.clear();
+	mRanges.clear();
+	mHasPoint = false;
+	mJointTime = -1.0;
+	mBuildTime = -1.0;
+	setTransform( Matrix44f::identity() );
+}
+
+void StrokeBatch::setTransform( const Matrix44f &transform )
+{
+	if ( mTransforms.size() % sMaxTransforms == 0 )
+	{
+		Range range = { mTransforms.size(), mIndices.size(), mSegments.size() };
+		mRanges.push_back( range );
+	}
+	mTransforms.push_back( transform );
+}
+
+bool StrokeBatch::empty() const
+{
+	return mIndices.empty() && mSegments.empty();
+}
+
+void StrokeBatch::beginStroke( int layer )
+{
+	mLayer = float( layer );
+	mHasPoint = false;
+}
+
+void StrokeBatch::addPoint( const StrokePoint &s )
+{
+	float transform = float( mTransforms.size() - 1 );
+
+	if ( mGpuRibbon )
+	{
+		if ( mHasPoint )
+		{
+			Segment segment;
+			segment.p0 = mLastPoint;
+			segment.p1 = s;
+			segment.layer = mLayer;
+			segment.transform = transform;
+			mSegments.push_back( segment );
+		}
+	}
+	else
+	{
+		GLuint v1 = (GLuint)mVertices.size();
+		for ( size_t r = 0; r < sRowCount; r++ )
+		{
+			float c = -1.f + r * 2.f / sSubdivCount;
+			Vertex v;
+			v.pos = s.p + c * s.w;
+			v.uvl = Vec3f( s.u, c * .5f + .5f, mLayer );
+			v.transform = transform;
+			mVertices.push_back( v );
+		}
+
+		// two triangles for each subdivision quad between the previous point and this one
+		if ( mHasPoint )
+		{
+			GLuint v0 = v1 - (GLuint)sRowCount;
+			for ( GLuint r = 0; r < sSubdivCount; r++ )
+			{
+				mIndices.push_back( v0 + r );
+				mIndices.push_back( v0 + r + 1 );
+				mIndices.push_back( v1 + r );
+				mIndices.push_back( v0 + r + 1 );
+				mIndices.push_back( v1 + r + 1 );
+				mIndices.push_back( v1 + r );
+			}
+		}
+	}
+
+	mLastPoint = s;
+	mHasPoint = true;
+}
+
+void StrokeBatch::draw()
+{
+	if ( empty() )
+		return;
+
+	gl::color( ColorA::white() );
+
+	if ( mGpuRibbon )
+		drawGpuRibbon();
+	else
+		drawCpuRibbon();
+}
+
+void StrokeBatch::drawCpuRibbon()
+{
+	if ( ! sBrushShader )
+		return;
+
+	/* the geometry is streamed, only the new segments are drawn every frame
+	 * onto the canvas, so every point is uploaded once, as it was with the
+	 * vertex rings of the strokes, but to a single buffer for all strokes */
+	if ( ! mVbo )
+	{
+		mVbo = gl::Vbo( GL_ARRAY_BUFFER );
+		mIndexVbo = gl::Vbo( GL_ELEMENT_ARRAY_BUFFER );
+	}
+	mVbo.bufferData( mVertices.size() * sizeof( Vertex ), &mVertices[ 0 ], GL_STREAM_DRAW );
+	mIndexVbo.bufferData( mIndices.size() * sizeof( GLuint ), &mIndices[ 0 ], GL_STREAM_DRAW );
+
+	sBrushShader.bind();
+	sBrushShader.uniform( "brushes", 0 );
+
+	GLint transformLoc = sBrushShader.getAttribLocation( "transform" );
+
+	glEnableClientState( GL_VERTEX_ARRAY );
+	glEnableClientState( GL_TEXTURE_COORD_ARRAY );
+	glEnableVertexAttribArray( transformLoc );
+	glVertexPointer( 2, GL_FLOAT, sizeof( Vertex ), (const GLvoid *)offsetof( Vertex, pos ) );
+	glTexCoordPointer( 3, GL_FLOAT, sizeof( Vertex ), (const GLvoid *)offsetof( Vertex, uvl ) );
+	glVertexAttribPointer( transformLoc, 1, GL_FLOAT, GL_FALSE, sizeof( Vertex ), (const GLvoid *)offsetof( Vertex, transform ) );
+
+	// a single call unless there are more users than transforms in the shader
+	for ( size_t i = 0; i < mRanges.size(); i++ )
+	{
+		size_t end = ( i + 1 < mRanges.size() ) ? mRanges[ i + 1 ].index : mIndices.size();
+		if ( end == mRanges[ i ].index )
+			continue;
+
+		setTransformUniforms( sBrushShader, mRanges[ i ] );
+		glDrawElements( GL_TRIANGLES, (GLsizei)( end - mRanges[ i ].index ), GL_UNSIGNED_INT,
+						(const GLvoid *)( mRanges[ i ].index * sizeof( GLuint ) ) );
+	}
+
+	glDisableVertexAttribArray( transformLoc );
+	glDisableClientState( GL_TEXTURE_COORD_ARRAY );
+	glDisableClientState( GL_VERTEX_ARRAY );
+	mIndexVbo.unbind();
+	mVbo.unbind();
+
+	sBrushShader.unbind();
+}
+
+void StrokeBatch::drawGpuRibbon()
+{
+	if ( ! mSegmentVbo )
+		mSegmentVbo = gl::Vbo( GL_ARRAY_BUFFER );
+	mSegmentVbo.bufferData( mSegments.size() * sizeof( Segment ), &mSegments[ 0 ], GL_STREAM_DRAW );
+
+	sRibbonShader.bind();
+	sRibbonShader.uniform( "brushes", 0 );
+
+	GLint cornerLoc = sRibbonShader.getAttribLocation( "corner" );
+	GLint pLoc[ 2 ] = { sRibbonShader.getAttribLocation( "p0" ), sRibbonShader.getAttribLocation( "p1" ) };
+	GLint wLoc[ 2 ] = { sRibbonShader.getAttribLocation( "w0" ), sRibbonShader.getAttribLocation( "w1" ) };
+	GLint uLoc[ 2 ] = { sRibbonShader.getAttribLocation( "u0" ), sRibbonShader.getAttribLocation( "u1" ) };
+	GLint layerLoc = sRibbonShader.getAttribLocation( "layer" );
+	GLint transformLoc = sRibbonShader.getAttribLocation( "transform" );
+
+	sCornerVbo.bind();
+	glEnableVertexAttribArray( cornerLoc );
+	glVertexAttribPointer( cornerLoc, 2, GL_FLOAT, GL_FALSE, sizeof( Vec2f ), (const GLvoid *)0 );
+
+	// one instance for each segment
+	mSegmentVbo.bind();
+	GLint instanceLocs[] = { pLoc[ 0 ], wLoc[ 0 ], uLoc[ 0 ], pLoc[ 1 ], wLoc[ 1 ], uLoc[ 1 ], layerLoc, transformLoc };
+	for ( size_t i = 0; i < sizeof( instanceLocs ) / sizeof( instanceLocs[ 0 ] ); i++ )
+	{
+		glEnableVertexAttribArray( instanceLocs[ i ] );
+		glVertexAttribDivisorARB( instanceLocs[ i ], 1 );
+	}
+
+	// a single call unless there are more users than transforms in the shader,
+	// there is no base instance, the attributes start at the first segment of the range
+	for ( size_t i = 0; i < mRanges.size(); i++ )
+	{
+		size_t first = mRanges[ i ].segment;
+		size_t end = ( i + 1 < mRanges.size() ) ? mRanges[ i + 1 ].segment : mSegments.size();
+		if ( end == first )
+			continue;
+
+		size_t base = first * sizeof( Segment );
+		for ( int e = 0; e < 2; e++ )
+		{
+			size_t offset = base + ( e ? offsetof( Segment, p1 ) : offsetof( Segment, p0 ) );
+			glVertexAttribPointer( pLoc[ e ], 2, GL_FLOAT, GL_FALSE, sizeof( Segment ),
+								   (const GLvoid *)( offset + offsetof( StrokePoint, p )));
+			glVertexAttribPointer( wLoc[ e ], 2, GL_FLOAT, GL_FALSE, sizeof( Segment ),
+								   (const GLvoid *)( offset + offsetof( StrokePoint, w )));
+			glVertexAttribPointer( uLoc[ e ], 1, GL_FLOAT, GL_FALSE, sizeof( Segment ),
+								   (const GLvoid *)( offset + offsetof( StrokePoint, u )));
+		}
+		glVertexAttribPointer( layerLoc, 1, GL_FLOAT, GL_FALSE, sizeof( Segment ),
+							   (const GLvoid *)( base + offsetof( Segment, layer ) ) );
+		glVertexAttribPointer( transformLoc, 1, GL_FLOAT, GL_FALSE, sizeof( Segment ),
+							   (const GLvoid *)( base + offsetof( Segment, transform ) ) );
+
+		setTransformUniforms( sRibbonShader, mRanges[ i ] );
+		glDrawArraysInstancedARB( GL_TRIANGLES, 0, (GLsizei)sIndicesPerSegment, (GLsizei)( end - first ) );
+	}
+
+	for ( size_t i = 0; i < sizeof( instanceLocs ) / sizeof( instanceLocs[ 0 ] ); i++ )
+	{
+		glVertexAttribDivisorARB( instanceLocs[ i ], 0 );
+		glDisableVertexAttribArray( instanceLocs[ i ] );
+	}
+	mSegmentVbo.unbind();
+	glDisableVertexAttribArray( cornerLoc );
+	sCornerVbo.unbind();
+
+	sRibbonShader.unbind();
+}
+
+void StrokeBatch::setTransformUniforms( gl::GlslProg &shader, const Range &range )
+{
+	size_t count = math< size_t >::min( mTransforms.size() - range.transform, sMaxTransforms );
+	shader.uniform( "transforms", &mTransforms[ range.transform ], (int)count );
+	shader.uniform( "transformBase", float( range.transform ) );
+}
+
+void StrokeBatch::getTriangles( vector< RibbonVertex > *triangles ) const
+{
+	triangles->clear();
+
+	if ( mGpuRibbon )
+	{
+		// expanded like StrokeRibbon.vert
+		static const vector< Vec2f > corners = getCorners();
+		triangles->reserve( mSegments.size() * corners.size() );
+		for ( vector< Segment >::const_iterator it = mSegments.begin(); it != mSegments.end(); ++it )
+		{
+			for ( vector< Vec2f >::const_iterator c = corners.begin(); c != corners.end(); ++c )
+			{
+				Vec2f p = lerp( it->p0.p, it->p1.p, c->x );
+				Vec2f w = lerp( it->p0.w, it->p1.w, c->x );
+				float u = lerp( it->p0.u, it->p1.u, c->x );
+
+				RibbonVertex v;
+				v.pos = mTransforms[ size_t( it->transform ) ].transformPointAffine( Vec3f( p + c->y * w, 0.f ) ).xy();
+				v.uvl = Vec3f( u, c->y * .5f + .5f, it->layer );
+				triangles->push_back( v );
+			}
+		}
+	}
+	else
+	{
+		triangles->reserve( mIndices.size() );
+		for ( vector< GLuint >::const_iterator it = mIndices.begin(); it != mIndices.end(); ++it )
+		{
+			const Vertex &vertex = mVertices[ *it ];
+			RibbonVertex v;
+			v.pos = mTransforms[ size_t( vertex.transform ) ].transformPointAffine( Vec3f( vertex.pos, 0.f ) ).xy();
+			v.uvl = vertex.uvl;
+			triangles->push_back( v );
+		}
+	}
+}
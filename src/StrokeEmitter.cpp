@@ -0,0 +1,128 @@
+#include "cinder/CinderMath.h"
+
+#include "StrokeEmitter.h"
+
+using namespace std;
+using namespace ci;
+
+// the head of the ribbon lags the spring by the pending samples, at most
+// a few simulation steps, so straight moves are not drawn late
+const size_t StrokeEmitter::sMaxPending      = 3;
+const int    StrokeEmitter::sMaxSubdivisions = 8;
+
+namespace {
+
+template< typename T >
+T catmullRom( const T &p0, const T &p1, const T &p2, const T &p3, float t )
+{
+	float t2 = t * t;
+	float t3 = t2 * t;
+	return ( p1 * 2.f + ( p2 - p0 ) * t +
+			 ( p0 * 2.f - p1 * 5.f + p2 * 4.f - p3 ) * t2 +
+			 ( p1 * 3.f - p0 - p2 * 3.f + p3 ) * t3 ) * .5f;
+}
+
+} // anonymous namespace
+
+StrokeEmitter::StrokeEmitter()
+: mTolerance( 0.f )
+, mMaxTurnAngle( 0.f )
+, mEmittedCount( 0 )
+{
+}
+
+void StrokeEmitter::reset()
+{
+	mPending.clear();
+	mEmittedCount = 0;
+}
+
+void StrokeEmitter::add( const StrokePoint &sample, StrokePointBuffer &points )
+{
+	if ( ( mEmittedCount == 0 ) || ( mTolerance <= 0.f ) )
+	{
+		mPending.clear();
+		emit( sample, points );
+		return;
+	}
+
+	if ( ( mPending.size() < sMaxPending ) && fits( sample ) )
+	{
+		mPending.push_back( sample );
+		return;
+	}
+
+	// the chord to the new sample is off, the path up to the last sample
+	// is still within tolerance
+	if ( ! mPending.empty() )
+	{
+		emit( mPending.back(), points );
+		mPending.clear();
+	}
+
+	mPending.push_back( sample );
+}
+
+void StrokeEmitter::flush( StrokePointBuffer &points )
+{
+	if ( mPending.empty() )
+		return;
+
+	emit( mPending.back(), points );
+	mPending.clear();
+}
+
+bool StrokeEmitter::fits( const StrokePoint &end ) const
+{
+	Vec2f chord = end.p - mLast.p;
+	float chordLength2 = chord.lengthSquared();
+	float tolerance2 = mTolerance * mTolerance;
+
+	for ( vector< StrokePoint >::const_iterator it = mPending.begin(); it != mPending.end(); ++it )
+	{
+		float t = 0.f;
+		if ( chordLength2 > 0.f )
+			t = math< float >::clamp( ( it->p - mLast.p ).dot( chord ) / chordLength2 );
+
+		// position and width error of the sample on the chord
+		if ( ( mLast.p + chord * t ).distanceSquared( it->p ) > tolerance2 )
+			return false;
+		if ( lerp( mLast.w, end.w, t ).distanceSquared( it->w ) > tolerance2 )
+			return false;
+	}
+
+	return true;
+}
+
+void StrokeEmitter::emit( const StrokePoint &point, StrokePointBuffer &points )
+{
+	if ( ( mEmittedCount >= 2 ) && ( mMaxTurnAngle > 0.f ) )
+	{
+		Vec2f d0 = mLast.p - mPrev.p;
+		Vec2f d1 = point.p - mLast.p;
+		float l0 = d0.length();
+		float l1 = d1.length();
+
+		if ( ( l0 > 0.f ) && ( l1 > 0.f ) )
+		{
+			float angle = math< float >::acos( math< float >::clamp( d0.dot( d1 ) / ( l0 * l1 ), -1.f, 1.f ) );
+			int subdivisions = math< int >::min( int( angle / mMaxTurnAngle ), sMaxSubdivisions );
+
+			// the point after the new one is not known yet, it is extrapolated
+			Vec2f next = point.p * 2.f - mLast.p;
+			for ( int i = 1; i <= subdivisions; i++ )
+			{
+				float t = i / float( subdivisions + 1 );
+				points.push_back( StrokePoint( catmullRom( mPrev.p, mLast.p, point.p, next, t ),
+											   lerp( mLast.w, point.w, t ),
+											   lerp( mLast.u, point.u, t ) ) );
+			}
+		}
+	}
+
+	points.push_back( point );
+
+	mPrev = mLast;
+	mLast = point;
+	mEmittedCount = math< size_t >::min( mEmittedCount + 1, 2 );
+}
@@ -5,6 +5,7 @@ using namespace ci;
 using namespace ci::app;
 
 const int StrokeManager::sGenerateid = 100;
+StrokeSimulation StrokeManager::sSimulation;
 
 mndl::params::PInterfaceGl StrokeManager::mParams         = mndl::params::PInterfaceGl();
 float                StrokeManager::mK              = 0.06f;
@@ -12,13 +13,29 @@ float                StrokeManager::mDamping        = 0.7f ;
 float                StrokeManager::mStrokeMinWidth = 100.0f ;
 float                StrokeManager::mStrokeMaxWidth = 160.0f;
 float                StrokeManager::mMaxVelocity    = 40.0f;
+bool                 StrokeManager::mGpuRibbon      = false;
+int                  StrokeManager::mPointHistory   = 1024;
+bool                 StrokeManager::mPointQuantized = false;
+bool                 StrokeManager::mBatchedSimulation = true;
+float                StrokeManager::mTessellationTolerance = 0.5f;
+float                StrokeManager::mTessellationAngle = 10.0f;
 Vec2i                StrokeManager::mSize           = Vec2i();
 
+StrokeManager::StrokeManager()
+: mRecorder( NULL )
+, mUserId( 0 )
+{
+	for( int slot = 0; slot < sSlotCount; ++slot )
+		mSlotUsed[ slot ] = false;
+}
 
-void StrokeManager::setup( Vec2i size )
+void StrokeManager::setup( Vec2i size, bool gl /* = true */ )
 {
 	mSize   = size;
 
+	if ( gl )
+		StrokeBatch::setup();
+
 	mParams = mndl::params::PInterfaceGl( "Stroke", Vec2i( 200, 150 ), Vec2i( 16, 176 ) );
 	mParams.addPersistentSizeAndPosition();
 
@@ -27,6 +44,12 @@ void StrokeManager::setup( Vec2i size )
 	mParams.addPersistentParam( "Stroke min width", &mStrokeMinWidth, 100.0f, "min=    0    max=  500     step= 0.5"  );
 	mParams.addPersistentParam( "Stroke max width", &mStrokeMaxWidth, 160.0f, "min= -500    max=  500     step= 0.5"  );
 	mParams.addPersistentParam( "Velocity max"    , &mMaxVelocity   , 40.0f , "min=    1    max=  100"                );
+	mParams.addPersistentParam( "GPU ribbon"      , &mGpuRibbon     , false );
+	mParams.addPersistentParam( "Point history"   , &mPointHistory  , 1024  , "min=   16    max=65536"                );
+	mParams.addPersistentParam( "Point quantized" , &mPointQuantized, false );
+	mParams.addPersistentParam( "Batched simulation", &mBatchedSimulation, true );
+	mParams.addPersistentParam( "Tessellation tolerance", &mTessellationTolerance, 0.5f, "min=0 max=10 step=0.1" );
+	mParams.addPersistentParam( "Tessellation angle", &mTessellationAngle, 10.0f, "min=0 max=90 step=1" );
 
 	/*
 	std::vector< std::pair< std::string, boost::any > > vars;
@@ -40,63 +63,87 @@ void StrokeManager::setup( Vec2i size )
 	*/
 }
 
+void StrokeManager::simulate()
+{
+	if ( ! mBatchedSimulation )
+		return;
+
+	sSimulation.setParams( mK, mDamping, 1.0f, mStrokeMinWidth, mStrokeMaxWidth, mMaxVelocity, mSize );
+	sSimulation.step();
+}
+
 void StrokeManager::update()
 {
-	for( Strokes::const_iterator it = mStrokes.begin(); it != mStrokes.end(); ++it )
+	for( int slot = 0; slot < sSlotCount; ++slot )
 	{
-		StrokeRef stroke = it->second;
-
-		stroke->setStiffness     ( mK              );
-		stroke->setDamping       ( mDamping        );
-		stroke->setStrokeMinWidth( mStrokeMinWidth );
-		stroke->setStrokeMaxWidth( mStrokeMaxWidth );
-		stroke->setMaxVelocity   ( mMaxVelocity    );
-		stroke->resize( mSize );
-		stroke->update();
+		if( mSlotUsed[ slot ] )
+			updateStroke( mSlots[ slot ] );
 	}
+
+	for( Strokes::const_iterator it = mStrokes.begin(); it != mStrokes.end(); ++it )
+		updateStroke( *it->second );
 }
 
-void StrokeManager::draw( const Calibrate &calibrate, const Vec2f &posRef )
+void StrokeManager::updateStroke( Stroke &stroke )
 {
-	for( Strokes::const_iterator it = mStrokes.begin(); it != mStrokes.end(); ++it )
-	{
-		StrokeRef stroke = it->second;
+	stroke.setStiffness     ( mK              );
+	stroke.setDamping       ( mDamping        );
+	stroke.setStrokeMinWidth( mStrokeMinWidth );
+	stroke.setStrokeMaxWidth( mStrokeMaxWidth );
+	stroke.setMaxVelocity   ( mMaxVelocity    );
+	stroke.setPointStorage  ( mPointHistory, mPointQuantized );
+	stroke.setBatched       ( mBatchedSimulation );
+	stroke.setTessellation  ( mTessellationTolerance, toRadians( mTessellationAngle ) );
+	stroke.resize( mSize );
+	stroke.update();
+}
 
-		stroke->draw( calibrate, posRef );
+void StrokeManager::buildGeometry( float alpha, StrokeBatch &batch )
+{
+	for( int slot = 0; slot < sSlotCount; ++slot )
+	{
+		if( mSlotUsed[ slot ] )
+			mSlots[ slot ].buildGeometry( alpha, batch );
 	}
+
+	for( Strokes::const_iterator it = mStrokes.begin(); it != mStrokes.end(); ++it )
+		it->second->buildGeometry( alpha, batch );
 }
 
-void StrokeManager::addPos( int id, Vec2f pos )
+void StrokeManager::addPos( int id, Vec2f pos, double time )
 {
-	StrokeRef stroke = findStroke( id );
+	Stroke *stroke = findStroke( id );
 
 	if( stroke )
-		stroke->addPos( pos );
+		stroke->addPos( pos, time );
 }
 
 void StrokeManager::setActive( int id, bool active )
 {
-	StrokeRef stroke = findStroke( id );
+	Stroke *stroke = findStroke( id );
 
 	if( stroke )
 		stroke->setActive( active );
 }
 
-void StrokeManager::setBrush( int id, gl::Texture brush )
+void StrokeManager::setBrush( int id, int layer )
 {
-	StrokeRef stroke = findStroke( id );
+	Stroke *stroke = findStroke( id );
 
 	if( stroke )
-		stroke->setBrush( brush );
+		stroke->setBrush( layer );
 }
 
 void StrokeManager::clear()
 {
-	for( Strokes::const_iterator it = mStrokes.begin(); it != mStrokes.end(); ++it )
+	for( int slot = 0; slot < sSlotCount; ++slot )
 	{
-		StrokeRef stroke = it->second;
-		stroke->clear();
+		if( mSlotUsed[ slot ] )
+			mSlots[ slot ].clear();
 	}
+
+	for( Strokes::const_iterator it = mStrokes.begin(); it != mStrokes.end(); ++it )
+		it->second->clear();
 }
 
 int StrokeManager::createStroke( int id /* = -1 */ )
@@ -106,8 +153,22 @@ int StrokeManager::createStroke( int id /* = -1 */ )
 	if( idStroke == -1 )
 		idStroke = generateStrokeId();
 
-	if( ! findStroke( idStroke ))
-		mStrokes[ idStroke ] = shared_ptr< Stroke >( new Stroke());
+	if( findStroke( idStroke ))
+		return idStroke;
+
+	int slot = getSlot( idStroke );
+	if( slot >= 0 )
+	{
+		mSlots[ slot ].reset( &sSimulation );
+		mSlots[ slot ].setRecorder( mRecorder, mUserId, idStroke );
+		mSlotUsed[ slot ] = true;
+	}
+	else
+	{
+		StrokeRef stroke( new Stroke( &sSimulation ));
+		stroke->setRecorder( mRecorder, mUserId, idStroke );
+		mStrokes[ idStroke ] = stroke;
+	}
 
 	return idStroke;
 }
@@ -117,16 +178,72 @@ void StrokeManager::destroyStroke( int id )
 	if( ! findStroke( id ))
 		return;
 
-	mStrokes.erase( id );
+	int slot = getSlot( id );
+	if( slot >= 0 )
+	{
+		mSlots[ slot ].release();
+		mSlotUsed[ slot ] = false;
+	}
+	else
+	{
+		mStrokes.erase( id );
+	}
+}
+
+void StrokeManager::destroyStrokes()
+{
+	for( int slot = 0; slot < sSlotCount; ++slot )
+	{
+		if( mSlotUsed[ slot ] )
+		{
+			mSlots[ slot ].release();
+			mSlotUsed[ slot ] = false;
+		}
+	}
+
+	mStrokes.clear();
+}
+
+void StrokeManager::reserve( int id )
+{
+	int slot = getSlot( id );
+	if( slot >= 0 )
+		mSlots[ slot ].setPointStorage( mPointHistory, mPointQuantized );
 }
 
-StrokeManager::StrokeRef StrokeManager::findStroke( int id )
+void StrokeManager::setRecorder( StrokeRecorder *recorder, unsigned userId )
 {
+	mRecorder = recorder;
+	mUserId   = userId;
+
+	for( int slot = 0; slot < sSlotCount; ++slot )
+	{
+		if( mSlotUsed[ slot ] )
+			mSlots[ slot ].setRecorder( mRecorder, mUserId, JointTable::sJoints[ slot ].id );
+	}
+
+	for( Strokes::const_iterator it = mStrokes.begin(); it != mStrokes.end(); ++it )
+		it->second->setRecorder( mRecorder, mUserId, it->first );
+}
+
+Stroke *StrokeManager::findStroke( int id )
+{
+	int slot = getSlot( id );
+	if( slot >= 0 )
+		return mSlotUsed[ slot ] ? &mSlots[ slot ] : NULL;
+
 	Strokes::const_iterator it = mStrokes.find( id );
 	if( it == mStrokes.end())
-		return StrokeRef();
+		return NULL;
 
-	return it->second;
+	return it->second.get();
+}
+
+int StrokeManager::getSlot( int id )
+{
+	// the generated ids are above the joint ids
+	int slot = ( id < sGenerateid ) ? JointTable::getSlot( XnSkeletonJoint( id ) ) : -1;
+	return ( slot < sSlotCount ) ? slot : -1;
 }
 
 int StrokeManager::generateStrokeId()
@@ -0,0 +1,109 @@
+#include "cinder/CinderMath.h"
+
+#include "StrokePointBuffer.h"
+
+using namespace std;
+using namespace ci;
+
+namespace {
+
+const float sPosScale   = 8.f;
+const float sWidthScale = 32.f;
+const float sUScale     = 1024.f;
+
+int16_t quantize( float v, float scale )
+{
+	return (int16_t)math< float >::clamp( math< float >::floor( v * scale + .5f ), -32768.f, 32767.f );
+}
+
+} // anonymous namespace
+
+StrokePointBuffer::StrokePointBuffer( size_t capacity /* = 1024 */, bool quantized /* = false */ )
+: mCapacity( 0 )
+, mQuantized( false )
+, mSize( 0 )
+, mLastU( 0.f )
+{
+	setup( capacity, quantized );
+}
+
+void StrokePointBuffer::setup( size_t capacity, bool quantized )
+{
+	capacity = math< size_t >::max( capacity, 2 );
+	if ( ( capacity == mCapacity ) && ( quantized == mQuantized ) )
+		return;
+
+	// keep the last points in the new storage with their indices
+	size_t first = math< size_t >::max( getFirst(), ( mSize > capacity ) ? mSize - capacity : 0 );
+	vector< StrokePoint > points( mSize - first );
+	if ( ! points.empty() )
+		copy( first, points.size(), &points[ 0 ] );
+
+	mCapacity = capacity;
+	mQuantized = quantized;
+	mPoints.clear();
+	mQuantizedPoints.clear();
+	if ( mQuantized )
+		mQuantizedPoints.resize( mCapacity );
+	else
+		mPoints.resize( mCapacity );
+
+	mSize = first;
+	for ( vector< StrokePoint >::const_iterator it = points.begin(); it != points.end(); ++it )
+		push_back( *it );
+}
+
+void StrokePointBuffer::push_back( const StrokePoint &point )
+{
+	size_t slot = mSize % mCapacity;
+	if ( mQuantized )
+		mQuantizedPoints[ slot ] = encode( point );
+	else
+		mPoints[ slot ] = point;
+
+	mLastU = point.u;
+	mSize++;
+}
+
+void StrokePointBuffer::clear()
+{
+	mSize = 0;
+	mLastU = 0.f;
+}
+
+StrokePoint StrokePointBuffer::operator[]( size_t i ) const
+{
+	size_t slot = i % mCapacity;
+	if ( mQuantized )
+		return decode( mQuantizedPoints[ slot ] );
+	else
+		return mPoints[ slot ];
+}
+
+void StrokePointBuffer::copy( size_t first, size_t count, StrokePoint *out ) const
+{
+	for ( size_t i = first; i < first + count; ++i )
+		*out++ = (*this)[ i ];
+}
+
+StrokePointBuffer::QuantizedPoint StrokePointBuffer::encode( const StrokePoint &point )
+{
+	QuantizedPoint q;
+	q.px = quantize( point.p.x, sPosScale );
+	q.py = quantize( point.p.y, sPosScale );
+	q.wx = quantize( point.w.x, sWidthScale );
+	q.wy = quantize( point.w.y, sWidthScale );
+	// wraps around every 64 texture repeats
+	q.u = (uint16_t)(int64_t)math< float >::floor( point.u * sUScale + .5f );
+	return q;
+}
+
+StrokePoint StrokePointBuffer::decode( const QuantizedPoint &q ) const
+{
+	const QuantizedPoint &last = mQuantizedPoints[ ( mSize - 1 ) % mCapacity ];
+	uint16_t du = (uint16_t)( last.u - q.u );
+
+	return StrokePoint( Vec2f( q.px, q.py ) / sPosScale,
+						Vec2f( q.wx, q.wy ) / sWidthScale,
+						mLastU - du / sUScale );
+}
@@ -0,0 +1,390 @@
+#include <cmath>
+#include <cstring>
+
+#include "StrokeRecorder.h"
+
+using namespace std;
+using namespace ci;
+
+namespace {
+
+const char    sMagic[ 4 ] = { 'P', 'R', 'S', 'T' };
+const uint8_t sVersion    = 1;
+
+enum RecordKind
+{
+	RECORD_POINT = 0,
+	RECORD_BEGIN = 1,
+	RECORD_END   = 2,
+	RECORD_TIME  = 3
+};
+
+void putVarint( vector< uint8_t > &buffer, uint64_t value )
+{
+	while ( value >= 0x80 )
+	{
+		buffer.push_back( uint8_t( value | 0x80 ) );
+		value >>= 7;
+	}
+	buffer.push_back( uint8_t( value ) );
+}
+
+uint64_t zigzag( int64_t value )
+{
+	return ( uint64_t( value ) << 1 ) ^ uint64_t( value >> 63 );
+}
+
+int64_t unzigzag( uint64_t value )
+{
+	return int64_t( value >> 1 ) ^ -int64_t( value & 1 );
+}
+
+int32_t quantize( float value, float scale )
+{
+	return int32_t( floor( value * scale + .5f ) );
+}
+
+// linear prediction from the last two points of a track
+int32_t predict( const int32_t q[ 2 ][ 5 ], int count, int c )
+{
+	if ( count >= 2 )
+		return 2 * q[ 1 ][ c ] - q[ 0 ][ c ];
+	else if ( count == 1 )
+		return q[ 1 ][ c ];
+	else
+		return 0;
+}
+
+} // anonymous namespace
+
+const float  StrokeRecorder::sPosScale      = 8.f;
+const float  StrokeRecorder::sWidthScale    = 32.f;
+const float  StrokeRecorder::sUScale        = 4096.f;
+const size_t StrokeRecorder::sQueueCapacity = 65536;
+
+StrokeRecorder::StrokeRecorder()
+: mRecording( false )
+, mTime( 0.0 )
+, mDropped( 0 )
+, mLastMs( 0 )
+{
+}
+
+StrokeRecorder::~StrokeRecorder()
+{
+	stop();
+}
+
+void StrokeRecorder::start( const fs::path &path )
+{
+	stop();
+
+	mFile.open( path.string().c_str(), ios::out | ios::binary | ios::trunc );
+	if ( ! mFile )
+		throw StrokeRecorderExc( "unable to write stroke recording " + path.string() );
+
+	mFile.write( sMagic, sizeof( sMagic ) );
+	mFile.put( char( sVersion ) );
+	float scales[ 3 ] = { sPosScale, sWidthScale, sUScale };
+	mFile.write( reinterpret_cast< const char * >( scales ), sizeof( scales ) );
+
+	mTracks.clear();
+	mIndexUsed.clear();
+	mLastMs = 0;
+
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		mPending.clear();
+		mPending.reserve( sQueueCapacity );
+		mDropped = 0;
+		mRecording = true;
+	}
+
+	mThread = thread( bind( &StrokeRecorder::writeThread, this ) );
+}
+
+void StrokeRecorder::stop()
+{
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		if ( ! mRecording )
+			return;
+		mRecording = false;
+	}
+	mCond.notify_all();
+	mThread.join();
+}
+
+bool StrokeRecorder::isRecording() const
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	return mRecording;
+}
+
+void StrokeRecorder::setTime( double seconds )
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	mTime = seconds;
+}
+
+void StrokeRecorder::addPoint( unsigned userId, int jointId, int brush, const StrokePoint &point )
+{
+	bool wake;
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		if ( ! mRecording )
+			return;
+
+		// memory stays bounded, points are dropped if the writer falls behind
+		if ( mPending.size() >= sQueueCapacity )
+		{
+			mDropped++;
+			return;
+		}
+
+		Event event;
+		event.end = false;
+		event.userId = userId;
+		event.jointId = jointId;
+		event.brush = brush;
+		event.time = mTime;
+		event.point = point;
+		wake = mPending.empty();
+		mPending.push_back( event );
+	}
+
+	if ( wake )
+		mCond.notify_all();
+}
+
+void StrokeRecorder::endStroke( unsigned userId, int jointId )
+{
+	bool wake;
+	{
+		std::lock_guard< std::mutex > lock( mMutex );
+		if ( ! mRecording )
+			return;
+
+		// stroke ends are never dropped, the writer would mix up the strokes otherwise
+		Event event;
+		event.end = true;
+		event.userId = userId;
+		event.jointId = jointId;
+		event.brush = 0;
+		event.time = mTime;
+		wake = mPending.empty();
+		mPending.push_back( event );
+	}
+
+	if ( wake )
+		mCond.notify_all();
+}
+
+size_t StrokeRecorder::getDropped() const
+{
+	std::lock_guard< std::mutex > lock( mMutex );
+	return mDropped;
+}
+
+void StrokeRecorder::writeThread()
+{
+	vector< Event > events;
+	events.reserve( sQueueCapacity );
+
+	bool recording = true;
+	while ( recording )
+	{
+		{
+			std::unique_lock< std::mutex > lock( mMutex );
+			while ( mRecording && mPending.empty() )
+				mCond.wait( lock );
+			events.swap( mPending );
+			recording = mRecording;
+		}
+
+		mBuffer.clear();
+		for ( vector< Event >::const_iterator it = events.begin(); it != events.end(); ++it )
+			encode( *it );
+		events.clear();
+
+		if ( ! recording )
+		{
+			while ( ! mTracks.empty() )
+				endTrack( mTracks.begin() );
+		}
+
+		if ( ! mBuffer.empty() )
+			mFile.write( reinterpret_cast< const char * >( &mBuffer[ 0 ] ), mBuffer.size() );
+	}
+
+	mFile.close();
+}
+
+void StrokeRecorder::encode( const Event &event )
+{
+	TrackKey key( event.userId, event.jointId );
+	map< TrackKey, Track >::iterator it = mTracks.find( key );
+
+	if ( event.end )
+	{
+		if ( it != mTracks.end() )
+			endTrack( it );
+		return;
+	}
+
+	int64_t ms = int64_t( floor( event.time * 1000.0 + .5 ) );
+	if ( ms > mLastMs )
+	{
+		putVarint( mBuffer, ( uint64_t( ms - mLastMs ) << 2 ) | RECORD_TIME );
+		mLastMs = ms;
+	}
+
+	// a brush change starts a new stroke
+	if ( ( it != mTracks.end() ) && ( it->second.brush != event.brush ) )
+	{
+		endTrack( it );
+		it = mTracks.end();
+	}
+
+	if ( it == mTracks.end() )
+	{
+		Track track;
+		track.index = 0;
+		while ( ( track.index < mIndexUsed.size() ) && mIndexUsed[ track.index ] )
+			track.index++;
+		if ( track.index == mIndexUsed.size() )
+			mIndexUsed.push_back( true );
+		else
+			mIndexUsed[ track.index ] = true;
+		track.brush = event.brush;
+		track.count = 0;
+		it = mTracks.insert( make_pair( key, track ) ).first;
+
+		putVarint( mBuffer, ( uint64_t( track.index ) << 2 ) | RECORD_BEGIN );
+		putVarint( mBuffer, event.userId );
+		putVarint( mBuffer, uint64_t( event.jointId ) );
+		putVarint( mBuffer, zigzag( event.brush ) );
+	}
+
+	Track &track = it->second;
+	int32_t q[ 5 ] = { quantize( event.point.p.x, sPosScale ), quantize( event.point.p.y, sPosScale ),
+					   quantize( event.point.w.x, sWidthScale ), quantize( event.point.w.y, sWidthScale ),
+					   quantize( event.point.u, sUScale ) };
+
+	putVarint( mBuffer, ( uint64_t( track.index ) << 2 ) | RECORD_POINT );
+	for ( int c = 0; c < 5; c++ )
+		putVarint( mBuffer, zigzag( int64_t( q[ c ] ) - predict( track.q, track.count, c ) ) );
+
+	memcpy( track.q[ 0 ], track.q[ 1 ], sizeof( track.q[ 1 ] ) );
+	memcpy( track.q[ 1 ], q, sizeof( q ) );
+	track.count++;
+}
+
+void StrokeRecorder::endTrack( map< TrackKey, Track >::iterator it )
+{
+	putVarint( mBuffer, ( uint64_t( it->second.index ) << 2 ) | RECORD_END );
+	mIndexUsed[ it->second.index ] = false;
+	mTracks.erase( it );
+}
+
+StrokeRecordReader::StrokeRecordReader( const fs::path &path )
+: mPosScale( 1.f )
+, mWidthScale( 1.f )
+, mUScale( 1.f )
+, mMs( 0 )
+{
+	mFile.open( path.string().c_str(), ios::in | ios::binary );
+
+	char magic[ 4 ];
+	float scales[ 3 ];
+	if ( ! mFile.read( magic, sizeof( magic ) ) || memcmp( magic, sMagic, sizeof( magic ) ) != 0 ||
+		 ( mFile.get() != sVersion ) ||
+		 ! mFile.read( reinterpret_cast< char * >( scales ), sizeof( scales ) ) )
+		throw StrokeRecorderExc( "not a stroke recording " + path.string() );
+
+	mPosScale   = scales[ 0 ];
+	mWidthScale = scales[ 1 ];
+	mUScale     = scales[ 2 ];
+}
+
+bool StrokeRecordReader::read( Event *event )
+{
+	uint64_t header;
+	while ( readVarint( &header ) )
+	{
+		uint64_t value = header >> 2;
+		int kind = int( header & 3 );
+
+		if ( kind == RECORD_TIME )
+		{
+			mMs += int64_t( value );
+			continue;
+		}
+
+		if ( value >= mTracks.size() )
+		{
+			if ( kind != RECORD_BEGIN )
+				return false; // corrupt
+			mTracks.resize( size_t( value ) + 1 );
+		}
+		Track &track = mTracks[ size_t( value ) ];
+
+		if ( kind == RECORD_BEGIN )
+		{
+			uint64_t userId, jointId, brush;
+			if ( ! readVarint( &userId ) || ! readVarint( &jointId ) || ! readVarint( &brush ) )
+				return false;
+			track.userId = unsigned( userId );
+			track.jointId = int( jointId );
+			track.brush = int( unzigzag( brush ) );
+			track.count = 0;
+			continue;
+		}
+
+		event->time = mMs / 1000.0;
+		event->userId = track.userId;
+		event->jointId = track.jointId;
+		event->brush = track.brush;
+
+		if ( kind == RECORD_END )
+		{
+			event->end = true;
+			return true;
+		}
+
+		int32_t q[ 5 ];
+		for ( int c = 0; c < 5; c++ )
+		{
+			uint64_t residual;
+			if ( ! readVarint( &residual ) )
+				return false;
+			q[ c ] = int32_t( predict( track.q, track.count, c ) + unzigzag( residual ) );
+		}
+		memcpy( track.q[ 0 ], track.q[ 1 ], sizeof( track.q[ 1 ] ) );
+		memcpy( track.q[ 1 ], q, sizeof( q ) );
+		track.count++;
+
+		event->end = false;
+		event->point = StrokePoint( Vec2f( q[ 0 ] / mPosScale, q[ 1 ] / mPosScale ),
+									Vec2f( q[ 2 ] / mWidthScale, q[ 3 ] / mWidthScale ),
+									q[ 4 ] / mUScale );
+		return true;
+	}
+
+	return false;
+}
+
+bool StrokeRecordReader::readVarint( uint64_t *value )
+{
+	*value = 0;
+	for ( int shift = 0; shift < 64; shift += 7 )
+	{
+		int c = mFile.get();
+		if ( c == EOF )
+			return false;
+		*value |= uint64_t( c & 0x7f ) << shift;
+		if ( ( c & 0x80 ) == 0 )
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,422 @@
+#include <cassert>
+
+#include "cinder/CinderMath.h"
+#include "cinder/app/App.h"
+
+#include "StrokeSimulation.h"
+
+#if defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) )
+#define STROKE_SIMULATION_SSE 1
+#include <emmintrin.h>
+#endif
+
+#if defined( __AVX__ )
+#define STROKE_SIMULATION_AVX 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace ci;
+
+namespace {
+
+const size_t sLaneAlign = 8; // widest kernel
+
+#ifndef NDEBUG
+bool sKernelChecked = false;
+#endif
+
+#if STROKE_SIMULATION_SSE
+struct SseOps
+{
+	typedef __m128 V;
+	static const size_t sWidth = 4;
+
+	static V    load( const float *p ) { return _mm_loadu_ps( p ); }
+	static void store( float *p, V v ) { _mm_storeu_ps( p, v ); }
+	static V    set( float f ) { return _mm_set1_ps( f ); }
+	static V    add( V a, V b ) { return _mm_add_ps( a, b ); }
+	static V    sub( V a, V b ) { return _mm_sub_ps( a, b ); }
+	static V    mul( V a, V b ) { return _mm_mul_ps( a, b ); }
+	static V    div( V a, V b ) { return _mm_div_ps( a, b ); }
+	static V    sqrt( V a ) { return _mm_sqrt_ps( a ); }
+	static V    vmin( V a, V b ) { return _mm_min_ps( a, b ); }
+	static V    vmax( V a, V b ) { return _mm_max_ps( a, b ); }
+	static V    and_( V a, V b ) { return _mm_and_ps( a, b ); }
+	static V    or_( V a, V b ) { return _mm_or_ps( a, b ); }
+	static V    andNot( V a, V b ) { return _mm_andnot_ps( a, b ); } // ~a & b
+	static V    gt( V a, V b ) { return _mm_cmpgt_ps( a, b ); }
+	static V    ge( V a, V b ) { return _mm_cmpge_ps( a, b ); }
+	static V    select( V mask, V a, V b ) { return or_( and_( mask, a ), andNot( mask, b ) ); }
+};
+#endif
+
+#if STROKE_SIMULATION_AVX
+struct AvxOps
+{
+	typedef __m256 V;
+	static const size_t sWidth = 8;
+
+	static V    load( const float *p ) { return _mm256_loadu_ps( p ); }
+	static void store( float *p, V v ) { _mm256_storeu_ps( p, v ); }
+	static V    set( float f ) { return _mm256_set1_ps( f ); }
+	static V    add( V a, V b ) { return _mm256_add_ps( a, b ); }
+	static V    sub( V a, V b ) { return _mm256_sub_ps( a, b ); }
+	static V    mul( V a, V b ) { return _mm256_mul_ps( a, b ); }
+	static V    div( V a, V b ) { return _mm256_div_ps( a, b ); }
+	static V    sqrt( V a ) { return _mm256_sqrt_ps( a ); }
+	static V    vmin( V a, V b ) { return _mm256_min_ps( a, b ); }
+	static V    vmax( V a, V b ) { return _mm256_max_ps( a, b ); }
+	static V    and_( V a, V b ) { return _mm256_and_ps( a, b ); }
+	static V    or_( V a, V b ) { return _mm256_or_ps( a, b ); }
+	static V    andNot( V a, V b ) { return _mm256_andnot_ps( a, b ); }
+	static V    gt( V a, V b ) { return _mm256_cmp_ps( a, b, _CMP_GT_OQ ); }
+	static V    ge( V a, V b ) { return _mm256_cmp_ps( a, b, _CMP_GE_OQ ); }
+	static V    select( V mask, V a, V b ) { return _mm256_blendv_ps( b, a, mask ); }
+};
+#endif
+
+} // anonymous namespace
+
+StrokeSimulation::StrokeSimulation()
+: mCount( 0 )
+, mK( 0.06f )
+, mDamping( 0.7f )
+, mMass( 1.0f )
+, mStrokeMinWidth( 100.0f )
+, mStrokeMaxWidth( 160.0f )
+, mMaxVelocity( 40.0f )
+, mSize( Vec2f::one() )
+{
+}
+
+size_t StrokeSimulation::allocate()
+{
+	if ( mFreeSlots.empty() )
+	{
+		size_t count = mCount;
+		resize( mCount + sLaneAlign );
+		for ( size_t i = mCount; i > count; --i )
+			mFreeSlots.push_back( i - 1 );
+	}
+
+	size_t slot = mFreeSlots.back();
+	mFreeSlots.pop_back();
+
+	mActive[ slot ] = true;
+	mHasTarget[ slot ] = false;
+	updateRunning( slot );
+	reset( slot );
+	return slot;
+}
+
+void StrokeSimulation::release( size_t slot )
+{
+	mActive[ slot ] = false;
+	updateRunning( slot );
+	reset( slot );
+	mFreeSlots.push_back( slot );
+}
+
+void StrokeSimulation::resize( size_t count )
+{
+	mCount = count;
+
+	mPosX.resize( count, 0.f );
+	mPosY.resize( count, 0.f );
+	mTargetX.resize( count, 0.f );
+	mTargetY.resize( count, 0.f );
+	mVelX.resize( count, 0.f );
+	mVelY.resize( count, 0.f );
+	mU.resize( count, 0.f );
+	mRunning.resize( count, 0.f );
+	mStarted.resize( count, 0.f );
+	mActive.resize( count, false );
+	mHasTarget.resize( count, false );
+
+	mEmitted.resize( count, 0.f );
+	mPointX.resize( count, 0.f );
+	mPointY.resize( count, 0.f );
+	mWidthX.resize( count, 0.f );
+	mWidthY.resize( count, 0.f );
+}
+
+void StrokeSimulation::setTarget( size_t slot, const Vec2f &target )
+{
+	mTargetX[ slot ] = target.x;
+	mTargetY[ slot ] = target.y;
+	mHasTarget[ slot ] = true;
+	updateRunning( slot );
+}
+
+void StrokeSimulation::setActive( size_t slot, bool active )
+{
+	mActive[ slot ] = active;
+	if ( ! active )
+		reset( slot );
+	updateRunning( slot );
+}
+
+void StrokeSimulation::reset( size_t slot )
+{
+	mStarted[ slot ] = 0.f;
+	mEmitted[ slot ] = 0.f;
+}
+
+void StrokeSimulation::updateRunning( size_t slot )
+{
+	mRunning[ slot ] = ( mActive[ slot ] && mHasTarget[ slot ] ) ? 1.f : 0.f;
+}
+
+void StrokeSimulation::setState( size_t slot, const Vec2f &pos, const Vec2f &vel, float u, bool started )
+{
+	mPosX[ slot ] = pos.x;
+	mPosY[ slot ] = pos.y;
+	mVelX[ slot ] = vel.x;
+	mVelY[ slot ] = vel.y;
+	mU[ slot ] = u;
+	mStarted[ slot ] = started ? 1.f : 0.f;
+	mEmitted[ slot ] = 0.f;
+}
+
+void StrokeSimulation::setParams( float k, float damping, float mass,
+								  float strokeMinWidth, float strokeMaxWidth, float maxVelocity,
+								  const Vec2i &size )
+{
+	mK = k;
+	mDamping = damping;
+	mMass = mass;
+	mStrokeMinWidth = strokeMinWidth;
+	mStrokeMaxWidth = strokeMaxWidth;
+	mMaxVelocity = maxVelocity;
+	mSize = Vec2f( size );
+}
+
+StrokePoint StrokeSimulation::getPoint( size_t slot ) const
+{
+	return StrokePoint( Vec2f( mPointX[ slot ], mPointY[ slot ] ),
+						Vec2f( mWidthX[ slot ], mWidthY[ slot ] ), mU[ slot ] );
+}
+
+void StrokeSimulation::step()
+{
+#ifndef NDEBUG
+	if ( ! sKernelChecked )
+	{
+		sKernelChecked = true;
+		checkKernel();
+	}
+#endif
+
+	stepVector( 0, mCount );
+}
+
+void StrokeSimulation::stepVector( size_t beg, size_t end )
+{
+#if STROKE_SIMULATION_AVX
+	stepKernel< AvxOps >( beg, end );
+#elif STROKE_SIMULATION_SSE
+	stepKernel< SseOps >( beg, end );
+#else
+	stepScalar( beg, end );
+#endif
+}
+
+void StrokeSimulation::checkKernel() const
+{
+	// springs starting, resting at the target, moving slowly, faster than the max velocity and inactive
+	const float states[][ 7 ] = { // target x, y, pos x, y, vel x, y, started
+		{ .5f, .5f, 0.f, 0.f, 0.f, 0.f, 0.f },
+		{ .3f, .7f, .3f, .71f, 0.f, 0.f, 1.f },
+		{ .2f, .1f, .8f, .9f, .01f, -.02f, 1.f },
+		{ .9f, .2f, .1f, .8f, .3f, .4f, 1.f },
+		{ .6f, .4f, .6f, .4f, 0.f, 0.f, 1.f },
+		{ .1f, .9f, .4f, .3f, -.05f, 0.f, 1.f },
+		{ .7f, .6f, .2f, .5f, 0.f, .1f, 1.f },
+		{ .4f, .8f, .5f, .5f, .02f, .02f, 1.f }
+	};
+	const size_t count = sizeof( states ) / sizeof( states[ 0 ] );
+
+	StrokeSimulation kernel, scalar;
+	StrokeSimulation *simulations[ 2 ] = { &kernel, &scalar };
+	for ( int s = 0; s < 2; s++ )
+	{
+		StrokeSimulation &simulation = *simulations[ s ];
+		simulation.mK = mK;
+		simulation.mDamping = mDamping;
+		simulation.mMass = mMass;
+		simulation.mStrokeMinWidth = mStrokeMinWidth;
+		simulation.mStrokeMaxWidth = mStrokeMaxWidth;
+		simulation.mMaxVelocity = mMaxVelocity;
+		simulation.mSize = mSize;
+
+		for ( size_t i = 0; i < count; i++ )
+		{
+			size_t slot = simulation.allocate();
+			simulation.setTarget( slot, Vec2f( states[ i ][ 0 ], states[ i ][ 1 ] ) );
+			simulation.setState( slot, Vec2f( states[ i ][ 2 ], states[ i ][ 3 ] ), Vec2f( states[ i ][ 4 ], states[ i ][ 5 ] ),
+								 0.f, states[ i ][ 6 ] != 0.f );
+		}
+		simulation.setActive( count - 1, false );
+	}
+
+	for ( int step = 0; step < 16; step++ )
+	{
+		kernel.stepVector( 0, kernel.mCount );
+		scalar.stepScalar( 0, scalar.mCount );
+
+		for ( size_t i = 0; i < count; i++ )
+		{
+			bool emitted = kernel.isEmitted( i );
+			if ( ( emitted == scalar.isEmitted( i ) ) &&
+				 ( kernel.getPos( i ) == scalar.getPos( i ) ) && ( kernel.getVel( i ) == scalar.getVel( i ) ) &&
+				 ( kernel.getU( i ) == scalar.getU( i ) ) &&
+				 ( ! emitted || ( ( kernel.getPoint( i ).p == scalar.getPoint( i ).p ) &&
+								  ( kernel.getPoint( i ).w == scalar.getPoint( i ).w ) ) ) )
+				continue;
+
+			app::console() << "StrokeSimulation: the vector kernel differs from the scalar step, spring "
+						   << i << " step " << step << endl;
+			assert( false );
+			return;
+		}
+	}
+}
+
+void StrokeSimulation::stepScalar( size_t beg, size_t end )
+{
+	float invMass = 1.f / mMass;
+
+	for ( size_t i = beg; i < end; i++ )
+	{
+		mEmitted[ i ] = 0.f;
+		if ( mRunning[ i ] == 0.f )
+			continue;
+
+		Vec2f pos( mPosX[ i ], mPosY[ i ] );
+		Vec2f target( mTargetX[ i ], mTargetY[ i ] );
+		Vec2f vel( mVelX[ i ], mVelY[ i ] );
+		float u = mU[ i ];
+		bool started = mStarted[ i ] != 0.f;
+
+		if ( ! started )
+		{
+			pos = target;
+			vel = Vec2f::zero();
+			u = 0.f;
+		}
+
+		Vec2f d = pos - target; // displacement from the target
+
+		// no new point if the target is close
+		if ( ( d.lengthSquared() < .001f ) && started )
+			continue;
+
+		Vec2f a = ( -mK * d ) * invMass; // Hooke's law and F = ma
+
+		vel = vel + a;
+		vel *= mDamping;
+		pos += vel;
+		u += vel.length();
+
+		Vec2f ang( -vel.y, vel.x );
+		ang.safeNormalize();
+
+		Vec2f scaledVel = vel * mSize;
+		float s = math< float >::clamp( scaledVel.length(), 0, mMaxVelocity ) / mMaxVelocity;
+		ang *= mStrokeMinWidth + ( mStrokeMaxWidth - mStrokeMinWidth ) * ( s * s );
+
+		mPosX[ i ] = pos.x;
+		mPosY[ i ] = pos.y;
+		mVelX[ i ] = vel.x;
+		mVelY[ i ] = vel.y;
+		mU[ i ] = u;
+		mStarted[ i ] = 1.f;
+
+		mEmitted[ i ] = 1.f;
+		mPointX[ i ] = pos.x * mSize.x;
+		mPointY[ i ] = pos.y * mSize.y;
+		mWidthX[ i ] = ang.x;
+		mWidthY[ i ] = ang.y;
+	}
+}
+
+template< typename Ops >
+void StrokeSimulation::stepKernel( size_t beg, size_t end )
+{
+	typedef typename Ops::V V;
+
+	const V zero = Ops::set( 0.f );
+	const V one = Ops::set( 1.f );
+	const V minusOne = Ops::set( -1.f );
+	const V negK = Ops::set( -mK );
+	const V invMass = Ops::set( 1.f / mMass );
+	const V damping = Ops::set( mDamping );
+	const V threshold = Ops::set( .001f );
+	const V sizeX = Ops::set( mSize.x );
+	const V sizeY = Ops::set( mSize.y );
+	const V maxVelocity = Ops::set( mMaxVelocity );
+	const V minWidth = Ops::set( mStrokeMinWidth );
+	const V widthRange = Ops::set( mStrokeMaxWidth - mStrokeMinWidth );
+
+	for ( size_t i = beg; i < end; i += Ops::sWidth )
+	{
+		V running = Ops::gt( Ops::load( &mRunning[ i ] ), zero );
+		V started = Ops::gt( Ops::load( &mStarted[ i ] ), zero );
+
+		V targetX = Ops::load( &mTargetX[ i ] );
+		V targetY = Ops::load( &mTargetY[ i ] );
+
+		// strokes without points start at the target
+		V posX = Ops::select( started, Ops::load( &mPosX[ i ] ), targetX );
+		V posY = Ops::select( started, Ops::load( &mPosY[ i ] ), targetY );
+		V velX = Ops::and_( started, Ops::load( &mVelX[ i ] ) );
+		V velY = Ops::and_( started, Ops::load( &mVelY[ i ] ) );
+		V u = Ops::and_( started, Ops::load( &mU[ i ] ) );
+
+		V dX = Ops::sub( posX, targetX );
+		V dY = Ops::sub( posY, targetY );
+		V d2 = Ops::add( Ops::mul( dX, dX ), Ops::mul( dY, dY ) );
+
+		// no new point if the target is close
+		V emit = Ops::and_( running, Ops::or_( Ops::ge( d2, threshold ), Ops::andNot( started, running ) ) );
+
+		V aX = Ops::mul( Ops::mul( negK, dX ), invMass );
+		V aY = Ops::mul( Ops::mul( negK, dY ), invMass );
+
+		velX = Ops::mul( Ops::add( velX, aX ), damping );
+		velY = Ops::mul( Ops::add( velY, aY ), damping );
+		posX = Ops::add( posX, velX );
+		posY = Ops::add( posY, velY );
+		V vel2 = Ops::add( Ops::mul( velX, velX ), Ops::mul( velY, velY ) );
+		V velLength = Ops::sqrt( vel2 );
+		u = Ops::add( u, velLength );
+
+		// perpendicular of the velocity, safe normalized
+		V nonZero = Ops::gt( vel2, zero );
+		V invLength = Ops::select( nonZero, Ops::div( one, velLength ), one );
+		V angX = Ops::mul( Ops::mul( minusOne, velY ), invLength );
+		V angY = Ops::mul( velX, invLength );
+
+		V scaledVelX = Ops::mul( velX, sizeX );
+		V scaledVelY = Ops::mul( velY, sizeY );
+		V scaledVel = Ops::sqrt( Ops::add( Ops::mul( scaledVelX, scaledVelX ), Ops::mul( scaledVelY, scaledVelY ) ) );
+		V s = Ops::div( Ops::vmin( Ops::vmax( scaledVel, zero ), maxVelocity ), maxVelocity );
+		V width = Ops::add( minWidth, Ops::mul( widthRange, Ops::mul( s, s ) ) );
+		angX = Ops::mul( angX, width );
+		angY = Ops::mul( angY, width );
+
+		Ops::store( &mPosX[ i ], Ops::select( emit, posX, Ops::load( &mPosX[ i ] ) ) );
+		Ops::store( &mPosY[ i ], Ops::select( emit, posY, Ops::load( &mPosY[ i ] ) ) );
+		Ops::store( &mVelX[ i ], Ops::select( emit, velX, Ops::load( &mVelX[ i ] ) ) );
+		Ops::store( &mVelY[ i ], Ops::select( emit, velY, Ops::load( &mVelY[ i ] ) ) );
+		Ops::store( &mU[ i ], Ops::select( emit, u, Ops::load( &mU[ i ] ) ) );
+		Ops::store( &mStarted[ i ], Ops::select( emit, one, Ops::load( &mStarted[ i ] ) ) );
+
+		Ops::store( &mEmitted[ i ], Ops::and_( emit, one ) );
+		Ops::store( &mPointX[ i ], Ops::mul( posX, sizeX ) );
+		Ops::store( &mPointY[ i ], Ops::mul( posY, sizeY ) );
+		Ops::store( &mWidthX[ i ], angX );
+		Ops::store( &mWidthY[ i ], angY );
+	}
+}
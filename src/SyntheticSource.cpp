@@ -0,0 +1,183 @@
+#include <algorithm>
+
+#include "cinder/app/App.h"
+#include "cinder/CinderMath.h"
+
+#include "JointTable.h"
+#include "SyntheticSource.h"
+
+using namespace std;
+using namespace ci;
+
+namespace
+{
+
+//! Returns a limb of \a length at \a angle radians from hanging down, positive angles point to +x.
+Vec2f limb( float length, float angle )
+{
+	return length * Vec2f( math< float >::sin( angle ), math< float >::cos( angle ) );
+}
+
+} // anonymous namespace
+
+float SyntheticSource::Wave::operator()( float time ) const
+{
+	return .5f * ( math< float >::sin( 2.f * float( M_PI ) * freq[ 0 ] * time + phase[ 0 ] ) +
+				   math< float >::sin( 2.f * float( M_PI ) * freq[ 1 ] * time + phase[ 1 ] ) );
+}
+
+SyntheticSource::SyntheticSource( const Options &options /* = Options() */ )
+: mOptions( options )
+, mRand( options.seed )
+, mNextId( 1 )
+, mFramePeriod( 1.0 / options.frameRate )
+, mStartTime( 0.0 )
+, mNextTime( 0.0 )
+, mLastTime( 0.0 )
+, mStarted( false )
+{
+}
+
+bool SyntheticSource::open()
+{
+	mStartTime = app::getElapsedSeconds();
+	mNextTime = mStartTime;
+	mLastTime = mStartTime;
+	mStatus = "Synthetic";
+	return true;
+}
+
+bool SyntheticSource::read( JointFrame *frame, vector< Event > *events )
+{
+	if ( ! mStarted )
+	{
+		for ( int i = 0; i < mOptions.userCount; i++ )
+			addBody( events );
+		mStarted = true;
+	}
+
+	double time = app::getElapsedSeconds();
+	if ( time < mNextTime )
+		return false;
+
+	// frames missed by a stall are skipped like the sensor would
+	mNextTime = std::max( mNextTime + mFramePeriod, time );
+	float dt = float( time - mLastTime );
+	mLastTime = time;
+
+	// each frame a user leaves with the probability of the churn in this frame and a new one comes
+	float leaving = mOptions.churn * dt;
+	while ( ! mBodies.empty() && ( mRand.nextFloat() < leaving ) )
+	{
+		vector< Body >::iterator body = mBodies.begin() + mRand.nextInt( int( mBodies.size() ) );
+		events->push_back( Event( USER_LOST, body->id ) );
+		mBodies.erase( body );
+		addBody( events );
+		leaving -= 1.f;
+	}
+
+	frame->time = time;
+	frame->joints.clear();
+	for ( vector< Body >::iterator it = mBodies.begin(); it != mBodies.end(); ++it )
+	{
+		moveBody( *it, dt );
+		addJoints( frame, *it, float( time - mStartTime ) );
+	}
+
+	return true;
+}
+
+void SyntheticSource::addBody( vector< Event > *events )
+{
+	Body body;
+	body.id = mNextId;
+	// joint streams store 16-bit user ids
+	mNextId = ( mNextId % 0xffff ) + 1;
+
+	body.scale = mRand.nextFloat( .6f, 1.1f );
+	body.x = mRand.nextFloat( 60.f, 580.f );
+	body.targetX = body.x;
+	body.speed = mRand.nextFloat( 20.f, 80.f );
+	body.gait = 0.f;
+	body.stride = 0.f;
+	for ( int i = 0; i < MOTION_COUNT; i++ )
+	{
+		for ( int j = 0; j < 2; j++ )
+		{
+			body.waves[ i ].freq[ j ] = mRand.nextFloat( .1f, .8f );
+			body.waves[ i ].phase[ j ] = mRand.nextFloat( 2.f * float( M_PI ) );
+		}
+	}
+
+	mBodies.push_back( body );
+	events->push_back( Event( USER_NEW, body.id ) );
+}
+
+void SyntheticSource::moveBody( Body &body, float dt )
+{
+	float dx = body.targetX - body.x;
+	float step = body.speed * dt;
+	float stride = 0.f;
+	if ( math< float >::abs( dx ) <= step )
+	{
+		// stands for a while, then walks on
+		body.x = body.targetX;
+		if ( mRand.nextFloat() < .2f * dt )
+			body.targetX = mRand.nextFloat( 60.f, 580.f );
+	}
+	else
+	{
+		body.x += ( dx > 0.f ) ? step : -step;
+		// a step cycle of two strides covers about a body height
+		body.gait += float( M_PI ) * step / ( 150.f * body.scale );
+		stride = .4f;
+	}
+
+	// the legs ease into and out of walking
+	body.stride += ( stride - body.stride ) * std::min( 4.f * dt, 1.f );
+}
+
+void SyntheticSource::addJoints( JointFrame *frame, const Body &body, float time )
+{
+	const Wave *w = body.waves;
+	float s = body.scale;
+
+	// further users are smaller and stand higher in the image
+	Vec2f torso( body.x, 220.f + 40.f * s );
+	float lean = .15f * w[ MOTION_LEAN ]( time );
+	Vec2f side = 45.f * s * Vec2f( math< float >::cos( lean ), math< float >::sin( lean ) );
+
+	Vec2f pos[ XN_SKEL_RIGHT_FOOT + 1 ];
+	pos[ XN_SKEL_TORSO ] = torso;
+	pos[ XN_SKEL_NECK ] = torso + limb( 80.f * s, float( M_PI ) - lean );
+	pos[ XN_SKEL_HEAD ] = pos[ XN_SKEL_NECK ] + limb( 30.f * s, float( M_PI ) - lean - .3f * w[ MOTION_HEAD ]( time ) );
+	pos[ XN_SKEL_LEFT_SHOULDER ] = pos[ XN_SKEL_NECK ] - side;
+	pos[ XN_SKEL_RIGHT_SHOULDER ] = pos[ XN_SKEL_NECK ] + side;
+
+	// the upper arms swing from hanging down to above the shoulders, the elbows bend further
+	float leftUpper  = 1.3f + 1.4f * w[ MOTION_LEFT_SHOULDER ]( time );
+	float leftLower  = leftUpper + .9f + .8f * w[ MOTION_LEFT_ELBOW ]( time );
+	float rightUpper = 1.3f + 1.4f * w[ MOTION_RIGHT_SHOULDER ]( time );
+	float rightLower = rightUpper + .9f + .8f * w[ MOTION_RIGHT_ELBOW ]( time );
+	pos[ XN_SKEL_LEFT_HAND ] = pos[ XN_SKEL_LEFT_SHOULDER ] + limb( 60.f * s, -leftUpper ) + limb( 55.f * s, -leftLower );
+	pos[ XN_SKEL_RIGHT_HAND ] = pos[ XN_SKEL_RIGHT_SHOULDER ] + limb( 60.f * s, rightUpper ) + limb( 55.f * s, rightLower );
+
+	// the legs swing in opposite phase while walking, the knee of the swinging leg bends
+	Vec2f hips = torso + Vec2f( 0.f, 40.f * s );
+	pos[ XN_SKEL_LEFT_HIP ] = hips - .55f * side;
+	pos[ XN_SKEL_RIGHT_HIP ] = hips + .55f * side;
+	float swing = body.stride * math< float >::sin( body.gait );
+	float knees = .1f + .1f * w[ MOTION_KNEES ]( time );
+	float leftBend = knees + 2.f * std::max( swing, 0.f );
+	float rightBend = knees + 2.f * std::max( -swing, 0.f );
+	pos[ XN_SKEL_LEFT_KNEE ] = pos[ XN_SKEL_LEFT_HIP ] + limb( 80.f * s, swing );
+	pos[ XN_SKEL_LEFT_FOOT ] = pos[ XN_SKEL_LEFT_KNEE ] + limb( 80.f * s, swing - leftBend );
+	pos[ XN_SKEL_RIGHT_KNEE ] = pos[ XN_SKEL_RIGHT_HIP ] + limb( 80.f * s, -swing );
+	pos[ XN_SKEL_RIGHT_FOOT ] = pos[ XN_SKEL_RIGHT_KNEE ] + limb( 80.f * s, -swing - rightBend );
+
+	for ( int i = 0; i < JointTable::sCount; i++ )
+	{
+		XnSkeletonJoint jointId = JointTable::sJoints[ i ].id;
+		frame->joints.push_back( JointFrame::Joint( body.id, jointId, pos[ jointId ], 1.f ));
+	}
+}
@@ -3,7 +3,6 @@
 #include <iomanip>
 
 #include "cinder/app/App.h"
-#include "cinder/ImageIo.h"
 
 #include "Utils.h"
 
@@ -40,22 +39,12 @@ string timeStamp()
 	return ss.str();
 }
 
-vector< pair< string, gl::Texture > > loadTextures( const fs::path &relativeDir )
+Matrix44f getRectMappingMatrix( const Rectf &srcRect, const Rectf &dstRect )
 {
-	vector< pair< string, gl::Texture > > textures;
-
-	fs::path dataPath = app::getAssetPath( relativeDir );
-
-	for( fs::directory_iterator it( dataPath ); it != fs::directory_iterator(); ++it )
-	{
-		if( fs::is_regular_file(*it) && ( it->path().extension().string() == ".png" ))
-		{
-			gl::Texture t = loadImage( app::loadAsset( relativeDir / it->path().filename()));
-			textures.push_back( std::pair< string, gl::Texture >( it->path().filename().string(), t ));
-		}
-	}
-
-	return textures;
+	Vec2f scale = dstRect.getSize() / srcRect.getSize();
+	Vec2f translate = dstRect.getUpperLeft() - srcRect.getUpperLeft() * scale;
+	return Matrix44f::createTranslation( Vec3f( translate, 0.f ) ) *
+		   Matrix44f::createScale( Vec3f( scale, 1.f ) );
 }
 
 } // namespace cinder